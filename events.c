@@ -1,363 +1,3245 @@
-// SPDX-FileCopyrightText: 2022 Oliver Old <oliver.old@outlook.com>
-// SPDX-License-Identifier: MIT
-
-#include "events.h"
-
-#include <assert.h>
-#include <errno.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <threads.h>
-
-struct _event_t {
-    mtx_t mtx;
-    cnd_t cnd;
-    bool signaled;
-    bool is_manual_reset;
-};
-
-typedef struct _event_wait_info_t {
-    mtx_t mtx;
-    cnd_t cnd;
-} _event_wait_info_t;
-
-typedef struct _event_waiter_t {
-    thrd_t thrd;
-    event_t* p_event;
-    _event_wait_info_t* p_wait_info;
-    bool joinable;
-    bool canceled;
-    bool done;
-} _event_waiter_t;
-
-static int _thrd_status_to_errno(int thrd_status) {
-    switch (thrd_status) {
-        case thrd_success:
-            return 0;
-        case thrd_nomem:
-            return ENOMEM;
-        case thrd_timedout:
-            return ETIMEDOUT;
-        case thrd_busy:
-            return EBUSY;
-        default:
-            return -1;
-    }
-}
-
-#define CHECK_THRD_ERR(err) _check_thrd_err(err, __FILE__, __LINE__, __func__)
-
-static void _check_thrd_err(int thrd_status, const char* file, unsigned int line, const char* func) {
-    if (thrd_status != thrd_success) {
-        char* strerr = strerror(_thrd_status_to_errno(thrd_status));
-        fprintf(stderr, "%s:%u: %s: %s\n", file, line, func, strerr);
-        abort();
-    }
-}
-
-static int _event_wait_helper(_event_waiter_t* p_waiter) {
-    event_t* p_event = p_waiter->p_event;
-    _event_wait_info_t* p_wait_info = p_waiter->p_wait_info;
-    bool signaled = false;
-    int thrd_status;
-    int thrd_status_2;
-
-    if ((thrd_status = mtx_lock(&p_event->mtx)) == thrd_success) {
-        if (!(signaled = p_event->signaled)) {
-            while ((thrd_status = cnd_wait(&p_event->cnd, &p_event->mtx)) == thrd_success) {
-                CHECK_THRD_ERR(mtx_lock(&p_wait_info->mtx));
-                bool canceled = p_waiter->canceled;
-                CHECK_THRD_ERR(mtx_unlock(&p_wait_info->mtx));
-
-                if (canceled || (signaled = p_event->signaled))
-                    break;
-            }
-        }
-
-        thrd_status_2 = mtx_unlock(&p_event->mtx);
-        if (thrd_status == thrd_success)
-            thrd_status = thrd_status_2;
-    }
-
-    CHECK_THRD_ERR(mtx_lock(&p_wait_info->mtx));
-
-    p_waiter->done = true;
-
-    CHECK_THRD_ERR(cnd_signal(&p_wait_info->cnd));
-    CHECK_THRD_ERR(mtx_unlock(&p_wait_info->mtx));
-
-    if (thrd_status != thrd_success)
-        return _thrd_status_to_errno(thrd_status);
-
-    if (!signaled)
-        return ECANCELED;
-
-    return 0;
-}
-
-size_t event_get_size(void) {
-    return sizeof(event_t);
-}
-
-event_error_t event_init(event_t* p_event, bool is_manual_reset, bool initial_state) {
-    if (!p_event)
-        return EINVAL;
-
-    int thrd_status;
-
-    if ((thrd_status = mtx_init(&p_event->mtx, mtx_plain)) == thrd_success) {
-        if ((thrd_status = cnd_init(&p_event->cnd)) == thrd_success) {
-            p_event->signaled = initial_state;
-            p_event->is_manual_reset = is_manual_reset;
-            return 0;
-        }
-
-        mtx_destroy(&p_event->mtx);
-    }
-
-    return _thrd_status_to_errno(thrd_status);
-}
-
-void event_destroy(event_t* p_event) {
-    if (p_event) {
-        cnd_destroy(&p_event->cnd);
-        mtx_destroy(&p_event->mtx);
-    }
-}
-
-event_error_t event_signal(event_t* p_event) {
-    if (!p_event)
-        return EINVAL;
-
-    int thrd_status;
-    int thrd_status_2;
-
-    if ((thrd_status = mtx_lock(&p_event->mtx)) == thrd_success) {
-        p_event->signaled = true;
-        thrd_status = p_event->is_manual_reset ? cnd_broadcast(&p_event->cnd) : cnd_signal(&p_event->cnd);
-        thrd_status_2 = mtx_unlock(&p_event->mtx);
-        if (thrd_status == thrd_success)
-            thrd_status = thrd_status_2;
-    }
-
-    return _thrd_status_to_errno(thrd_status);
-}
-
-event_error_t event_reset(event_t* p_event) {
-    if (!p_event)
-        return EINVAL;
-
-    int thrd_status;
-
-    if ((thrd_status = mtx_lock(&p_event->mtx)) == thrd_success) {
-        p_event->signaled = false;
-        thrd_status = mtx_unlock(&p_event->mtx);
-    }
-
-    return _thrd_status_to_errno(thrd_status);
-}
-
-event_error_t event_pulse(event_t* p_event) {
-    event_error_t err;
-    if (!(err = event_signal(p_event)))
-        err = event_reset(p_event);
-    return err;
-}
-
-event_error_t event_wait(event_t* p_event, const struct timespec* p_time) {
-    if (!p_event)
-        return EINVAL;
-
-    int thrd_status;
-    int thrd_status_2;
-
-    if ((thrd_status = mtx_lock(&p_event->mtx)) == thrd_success) {
-        do {
-            if (p_event->signaled) {
-                if (!p_event->is_manual_reset)
-                    p_event->signaled = false;
-                break;
-            }
-        } while ((thrd_status = p_time ? cnd_timedwait(&p_event->cnd, &p_event->mtx, p_time) : cnd_wait(&p_event->cnd, &p_event->mtx)) == thrd_success);
-
-        thrd_status_2 = mtx_unlock(&p_event->mtx);
-        if (thrd_status == thrd_success)
-            thrd_status = thrd_status_2;
-    }
-
-    return _thrd_status_to_errno(thrd_status);
-}
-
-event_error_t event_wait_multiple(event_t** p_events, size_t c_events, bool wait_all, const struct timespec* p_time, size_t* p_idx_signaled_event) {
-    if (p_idx_signaled_event)
-        *p_idx_signaled_event = 0;
-
-    if (!c_events)
-        return 0;
-
-    if (!p_events || (!wait_all && !p_idx_signaled_event))
-        return EINVAL;
-
-    if (c_events == 1)
-        return event_wait(*p_events, p_time);
-
-    _event_waiter_t* p_waiters;
-    _event_wait_info_t wait_info;
-    int err = 0;
-    int thrd_status = thrd_success;
-    int thrd_status_2;
-    bool all_signaled;
-
-    p_waiters = calloc(c_events, sizeof(_event_waiter_t));
-    if (!p_waiters)
-        return errno;
-
-    if ((thrd_status = mtx_init(&wait_info.mtx, mtx_plain)) != thrd_success)
-        goto clean_up_waiters;
-
-    if ((thrd_status = cnd_init(&wait_info.cnd)) != thrd_success)
-        goto clean_up_wait_info_mtx;
-
-restart_wait:
-    for (size_t i = 0; i < c_events; ++i) {
-        _event_waiter_t* p_waiter = &p_waiters[i];
-        p_waiter->p_event = p_events[i];
-        p_waiter->p_wait_info = &wait_info;
-        p_waiter->joinable = true;
-        p_waiter->canceled = false;
-        p_waiter->done = false;
-
-        if ((thrd_status = thrd_create(&p_waiter->thrd, (thrd_start_t)_event_wait_helper, p_waiter)) != thrd_success) {
-            for (size_t j = 0; j < i; ++j)
-                thrd_join(p_waiters[j].thrd, NULL);
-
-            goto clean_up_wait_info_cnd;
-        }
-    }
-
-    CHECK_THRD_ERR(mtx_lock(&wait_info.mtx));
-
-    if (thrd_status != thrd_success)
-        goto clean_up_threads;
-
-    do {
-        if (wait_all) {
-            all_signaled = true;
-            for (size_t i = 0; i < c_events; ++i) {
-                _event_waiter_t* p_waiter = &p_waiters[i];
-
-                if (p_waiter->done) {
-                    if (p_waiter->joinable) {
-                        thrd_status = thrd_join(p_waiter->thrd, &err);
-                        p_waiter->joinable = false;
-
-                        if (thrd_status != thrd_success) {
-                            err = 0;
-                            goto clean_up_threads;
-                        }
-
-                        if (err)
-                            goto clean_up_threads;
-                    }
-                } else {
-                    all_signaled = false;
-                }
-            }
-
-            if (all_signaled) {
-                size_t locked;
-                for (locked = 0; locked < c_events; ++locked) {
-                    if ((thrd_status = mtx_lock(&p_events[locked]->mtx)) != thrd_success)
-                        break;
-
-                    if (!p_events[locked]->signaled) {
-                        all_signaled = false;
-                        break;
-                    }
-                }
-
-                thrd_status_2 = thrd_success;
-                for (size_t i = 0; i < locked; ++i) {
-                    if (all_signaled && !p_events[i]->is_manual_reset)
-                        p_events[i]->signaled = false;
-
-                    thrd_status_2 = mtx_unlock(&p_events[i]->mtx);
-                }
-
-                if (thrd_status == thrd_success)
-                    thrd_status = thrd_status_2;
-
-                goto clean_up_threads;
-            }
-        } else {
-            for (size_t i = 0; i < c_events; ++i) {
-                _event_waiter_t* p_waiter = &p_waiters[i];
-
-                if (p_waiter->done) {
-                    if (p_waiter->joinable) {
-                        thrd_status = thrd_join(p_waiter->thrd, &err);
-                        p_waiter->joinable = false;
-
-                        if (thrd_status != thrd_success) {
-                            err = 0;
-                            goto clean_up_threads;
-                        }
-
-                        if (err)
-                            goto clean_up_threads;
-                    }
-
-                    *p_idx_signaled_event = i;
-
-                    if (!p_events[i]->is_manual_reset && mtx_lock(&p_events[i]->mtx) == thrd_success) {
-                        p_events[i]->signaled = false;
-                        mtx_unlock(&p_events[i]->mtx);
-                    }
-
-                    goto clean_up_threads;
-                }
-            }
-        }
-    } while ((thrd_status = p_time ? cnd_timedwait(&wait_info.cnd, &wait_info.mtx, p_time) : cnd_wait(&wait_info.cnd, &wait_info.mtx)) == thrd_success);
-
-clean_up_threads:
-    for (size_t i = 0; i < c_events; ++i) {
-        _event_waiter_t* p_waiter = &p_waiters[i];
-
-        if (!p_waiter->done) {
-            event_t* p_event = p_waiters[i].p_event;
-
-            CHECK_THRD_ERR(mtx_lock(&p_event->mtx));
-            p_waiter->canceled = true;
-            CHECK_THRD_ERR(cnd_broadcast(&p_event->cnd));
-            CHECK_THRD_ERR(mtx_unlock(&p_event->mtx));
-        }
-    }
-
-    CHECK_THRD_ERR(mtx_unlock(&wait_info.mtx));
-
-    for (size_t i = 0; i < c_events; ++i) {
-        _event_waiter_t* p_waiter = &p_waiters[i];
-
-        if (p_waiter->joinable)
-            thrd_join(p_waiter->thrd, NULL);
-    }
-
-    if (wait_all && !err && thrd_status == thrd_success && !all_signaled)
-        goto restart_wait;
-
-clean_up_wait_info_cnd:
-    cnd_destroy(&wait_info.cnd);
-
-clean_up_wait_info_mtx:
-    mtx_destroy(&wait_info.mtx);
-
-clean_up_waiters:
-    free(p_waiters);
-
-    if (err)
-        return err;
-
-    return _thrd_status_to_errno(thrd_status);
-}
+// SPDX-FileCopyrightText: 2022 Oliver Old <oliver.old@outlook.com>
+// SPDX-License-Identifier: MIT
+
+// pthread_attr_setstack and anonymous mappings for wait_multiple helper stacks where pthreads is available,
+// clock_gettime for batch delays and the pthread backend, and syscall for the futex backend.
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include "events.h"
+#include "events_backend.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+// USDT probes for bpftrace/perf, provider "events". Each probe is a single nop until a tracer attaches.
+//   signal(event, is_manual_reset)       wait__entry(event)   wait__block(event)   wait__return(event, err)
+//   wait_multiple__entry(events, count, wait_all)             wait_multiple__return(events, err)
+//   helper__start(event)                 helper__exit(event, signaled)
+// Enabled when <sys/sdt.h> is available unless EVENTS_NO_USDT is defined.
+#if !defined(EVENTS_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define EVENTS_HAVE_USDT
+#endif
+#endif
+
+#ifdef EVENTS_HAVE_USDT
+#define EVENT_PROBE1(name, a) DTRACE_PROBE1(events, name, a)
+#define EVENT_PROBE2(name, a, b) DTRACE_PROBE2(events, name, a, b)
+#define EVENT_PROBE3(name, a, b, c) DTRACE_PROBE3(events, name, a, b, c)
+#else
+#define EVENT_PROBE1(name, a) ((void)0)
+#define EVENT_PROBE2(name, a, b) ((void)0)
+#define EVENT_PROBE3(name, a, b, c) ((void)0)
+#endif
+
+// With pthreads, wait_multiple helper threads run on small cached stacks instead of the thrd_create default.
+#if defined(__has_include)
+#if __has_include(<pthread.h>)
+#include <pthread.h>
+#define EVENTS_HAVE_PTHREAD
+#if __has_include(<sys/mman.h>) && __has_include(<unistd.h>)
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(MAP_ANONYMOUS) || defined(MAP_ANON)
+#define EVENTS_HAVE_HELPER_STACKS
+#endif
+#endif
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define _EVENT_CALLER() __builtin_return_address(0)
+#else
+#define _EVENT_CALLER() NULL
+#endif
+
+#ifdef EVENTS_METRICS
+// Wait time histogram bucket upper bounds are 1us * 10^i; the last bucket is +Inf.
+#define EVENT_METRICS_BUCKETS 9
+
+typedef struct _event_counters_t {
+    atomic_uint_least64_t signals;
+    atomic_uint_least64_t waits;
+    atomic_uint_least64_t timeouts;
+    atomic_uint_least64_t contended;
+    atomic_uint_least64_t wait_ns;
+    atomic_uint_least64_t wait_buckets[EVENT_METRICS_BUCKETS];
+} _event_counters_t;
+#endif
+
+struct _event_t {
+    _event_mtx_t mtx;
+    _event_cnd_t cnd;
+    bool signaled;
+    bool is_manual_reset;
+    // Threads in event_wait_until or event_wait_changed. While there are any, signals wake all waiters.
+    unsigned c_generation_waiters;
+    // Advanced by every signal under the lock, read without it by event_get_version.
+    atomic_uint_least64_t generation;
+    _Atomic(const char*) name;
+#ifdef EVENTS_TRACE
+    uint_least64_t trace_flow_id;
+#endif
+#ifdef EVENTS_METRICS
+    _event_counters_t counters;
+    struct _event_t* p_metrics_prev;
+    struct _event_t* p_metrics_next;
+    bool metrics_registered;
+#endif
+};
+
+typedef struct _event_wait_info_t {
+    _event_mtx_t mtx;
+    _event_cnd_t cnd;
+} _event_wait_info_t;
+
+typedef struct _event_waiter_t {
+#ifdef EVENTS_HAVE_PTHREAD
+    pthread_t thrd;
+    // Cached stack the helper runs on, or null if it was created with the default stack.
+    void* p_stack;
+    int result;
+#else
+    thrd_t thrd;
+#endif
+    event_t* p_event;
+    _event_wait_info_t* p_wait_info;
+    bool joinable;
+    bool canceled;
+    bool done;
+} _event_waiter_t;
+
+static int _thrd_status_to_errno(int thrd_status) {
+    switch (thrd_status) {
+        case thrd_success:
+            return 0;
+        case thrd_nomem:
+            return ENOMEM;
+        case thrd_timedout:
+            return ETIMEDOUT;
+        case thrd_busy:
+            return EBUSY;
+        default:
+            return -1;
+    }
+}
+
+#define CHECK_THRD_ERR(err) _check_thrd_err(err, __FILE__, __LINE__, __func__)
+
+static void _check_thrd_err(int thrd_status, const char* file, unsigned int line, const char* func) {
+    if (thrd_status != thrd_success) {
+        char* strerr = strerror(_thrd_status_to_errno(thrd_status));
+        fprintf(stderr, "%s:%u: %s: %s\n", file, line, func, strerr);
+        abort();
+    }
+}
+
+static inline uint_least64_t _event_now_ns(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint_least64_t)ts.tv_sec * 1000000000u + (uint_least64_t)ts.tv_nsec;
+}
+
+// Time for measuring delays, which wall clock steps must neither cut short nor stretch. TIME_UTC where there is no
+// CLOCK_MONOTONIC.
+static inline uint_least64_t _event_monotonic_ns(void) {
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint_least64_t)ts.tv_sec * 1000000000u + (uint_least64_t)ts.tv_nsec;
+#else
+    return _event_now_ns();
+#endif
+}
+
+static inline unsigned long _event_thread_id(void) {
+    static atomic_ulong next_id = 1;
+    static _Thread_local unsigned long id;
+
+    if (!id)
+        id = atomic_fetch_add_explicit(&next_id, 1, memory_order_relaxed);
+
+    return id;
+}
+
+typedef struct _event_name_t {
+    struct _event_name_t* p_next;
+    char name[EVENT_NAME_MAX];
+#ifdef EVENTS_METRICS
+    // Counters of destroyed or renamed events, so exported counters never go backwards.
+    _event_counters_t retired;
+#endif
+} _event_name_t;
+
+static once_flag _event_names_once = ONCE_FLAG_INIT;
+static mtx_t _event_names_mtx;
+static _event_name_t* _event_names;
+
+static void _event_names_init(void) {
+    CHECK_THRD_ERR(mtx_init(&_event_names_mtx, mtx_plain));
+}
+
+// Names are interned and never freed so that instrumentation can keep pointers to them after the event is destroyed.
+static const char* _event_intern_name(const char* name) {
+    char truncated[EVENT_NAME_MAX];
+    const char* p_interned = NULL;
+
+    snprintf(truncated, sizeof(truncated), "%s", name);
+
+    call_once(&_event_names_once, _event_names_init);
+    CHECK_THRD_ERR(mtx_lock(&_event_names_mtx));
+
+    for (_event_name_t* p_name = _event_names; p_name; p_name = p_name->p_next) {
+        if (!strcmp(p_name->name, truncated)) {
+            p_interned = p_name->name;
+            break;
+        }
+    }
+
+    if (!p_interned) {
+        _event_name_t* p_name = calloc(1, sizeof(_event_name_t));
+        if (p_name) {
+            memcpy(p_name->name, truncated, sizeof(truncated));
+            p_name->p_next = _event_names;
+            _event_names = p_name;
+            p_interned = p_name->name;
+        }
+    }
+
+    CHECK_THRD_ERR(mtx_unlock(&_event_names_mtx));
+    return p_interned;
+}
+
+#ifdef EVENTS_PROFILE
+// Must be a power of two.
+#define EVENT_PROFILE_SITES 1024
+
+typedef struct _event_profile_site_t {
+    atomic_uintptr_t caller;
+    atomic_uint_least64_t count;
+    atomic_uint_least64_t total_ns;
+    atomic_uint_least64_t max_ns;
+    _Atomic(const char*) event_name;
+} _event_profile_site_t;
+
+static _event_profile_site_t _event_profile_sites[EVENT_PROFILE_SITES];
+static atomic_uint_least64_t _event_profile_dropped;
+
+static void _event_profile_record(const void* caller, const event_t* p_event, uint_least64_t start_ns) {
+    uint_least64_t elapsed_ns = _event_now_ns() - start_ns;
+    uintptr_t key = (uintptr_t)caller;
+    size_t idx = (size_t)((key >> 4) * 0x9E3779B97F4A7C15u);
+
+    for (size_t probe = 0; probe < EVENT_PROFILE_SITES; ++probe) {
+        _event_profile_site_t* p_site = &_event_profile_sites[(idx + probe) & (EVENT_PROFILE_SITES - 1)];
+        uintptr_t site_caller = atomic_load_explicit(&p_site->caller, memory_order_acquire);
+
+        if (site_caller != key) {
+            if (site_caller)
+                continue;
+
+            if (!atomic_compare_exchange_strong(&p_site->caller, &site_caller, key) && site_caller != key)
+                continue;
+        }
+
+        atomic_fetch_add_explicit(&p_site->count, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&p_site->total_ns, elapsed_ns, memory_order_relaxed);
+        if (p_event)
+            atomic_store_explicit(&p_site->event_name, atomic_load_explicit(&p_event->name, memory_order_relaxed), memory_order_relaxed);
+
+        uint_least64_t max_ns = atomic_load_explicit(&p_site->max_ns, memory_order_relaxed);
+        while (elapsed_ns > max_ns && !atomic_compare_exchange_weak_explicit(&p_site->max_ns, &max_ns, elapsed_ns, memory_order_relaxed, memory_order_relaxed))
+            ;
+        return;
+    }
+
+    atomic_fetch_add_explicit(&_event_profile_dropped, 1, memory_order_relaxed);
+}
+
+typedef struct _event_profile_entry_t {
+    uintptr_t caller;
+    uint_least64_t count;
+    uint_least64_t total_ns;
+    uint_least64_t max_ns;
+    const char* event_name;
+} _event_profile_entry_t;
+
+static int _event_profile_entry_cmp(const void* p_lhs, const void* p_rhs) {
+    uint_least64_t lhs = ((const _event_profile_entry_t*)p_lhs)->total_ns;
+    uint_least64_t rhs = ((const _event_profile_entry_t*)p_rhs)->total_ns;
+    return (lhs < rhs) - (lhs > rhs);
+}
+
+typedef struct _event_profile_phase_t {
+    atomic_uint_least64_t count;
+    atomic_uint_least64_t total_ns;
+    atomic_uint_least64_t max_ns;
+} _event_profile_phase_t;
+
+static _event_profile_phase_t _event_profile_phases[EVENT_PHASE_COUNT];
+
+// Account the time since '*p_mark_ns' to 'phase' and start the next phase from now.
+static void _event_profile_phase(event_phase_t phase, uint_least64_t* p_mark_ns) {
+    uint_least64_t now_ns = _event_now_ns();
+    uint_least64_t elapsed_ns = now_ns - *p_mark_ns;
+    _event_profile_phase_t* p_phase = &_event_profile_phases[phase];
+
+    *p_mark_ns = now_ns;
+    atomic_fetch_add_explicit(&p_phase->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&p_phase->total_ns, elapsed_ns, memory_order_relaxed);
+
+    uint_least64_t max_ns = atomic_load_explicit(&p_phase->max_ns, memory_order_relaxed);
+    while (elapsed_ns > max_ns && !atomic_compare_exchange_weak_explicit(&p_phase->max_ns, &max_ns, elapsed_ns, memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+#define EVENT_PROFILE_BEGIN() uint_least64_t _profile_start_ns = _event_now_ns()
+#define EVENT_PROFILE_END(caller, p_event) _event_profile_record(caller, p_event, _profile_start_ns)
+#define EVENT_PHASE_BEGIN() uint_least64_t _phase_mark_ns = _event_now_ns()
+#define EVENT_PHASE_END(phase) _event_profile_phase(phase, &_phase_mark_ns)
+#else
+#define EVENT_PROFILE_BEGIN() ((void)0)
+#define EVENT_PROFILE_END(caller, p_event) ((void)(caller))
+#define EVENT_PHASE_BEGIN() ((void)0)
+#define EVENT_PHASE_END(phase) ((void)0)
+#endif
+
+#ifdef EVENTS_TRACE
+// Records per thread. Must be a power of two.
+#define EVENT_TRACE_RING_SIZE 4096
+
+typedef enum _event_trace_kind_t {
+    _EVENT_TRACE_SIGNAL,
+    _EVENT_TRACE_RESET,
+    _EVENT_TRACE_WAIT_BEGIN,
+    _EVENT_TRACE_WAIT_END,
+    _EVENT_TRACE_TIMEOUT,
+    _EVENT_TRACE_WAIT_MULTIPLE_BEGIN,
+    _EVENT_TRACE_WAIT_MULTIPLE_END,
+} _event_trace_kind_t;
+
+typedef struct _event_trace_record_t {
+    atomic_uint_least64_t ts_ns;
+    atomic_uint_least64_t flow_id;
+    _Atomic(const event_t*) p_event;
+    _Atomic(const char*) event_name;
+    atomic_int kind;
+} _event_trace_record_t;
+
+// One ring per tracing thread, written only by its owner. Rings are never freed so that
+// event_trace_write can walk them while other threads keep tracing.
+typedef struct _event_trace_ring_t {
+    struct _event_trace_ring_t* p_next;
+    unsigned long thread_id;
+    atomic_size_t head;
+    _event_trace_record_t records[EVENT_TRACE_RING_SIZE];
+} _event_trace_ring_t;
+
+static _Atomic(_event_trace_ring_t*) _event_trace_rings;
+static atomic_uint_least64_t _event_trace_next_flow_id = 1;
+
+static _event_trace_ring_t* _event_trace_get_ring(void) {
+    static _Thread_local _event_trace_ring_t* p_ring;
+    static _Thread_local bool alloc_failed;
+
+    if (p_ring || alloc_failed)
+        return p_ring;
+
+    if (!(p_ring = calloc(1, sizeof(_event_trace_ring_t)))) {
+        alloc_failed = true;
+        return NULL;
+    }
+
+    p_ring->thread_id = _event_thread_id();
+    p_ring->p_next = atomic_load_explicit(&_event_trace_rings, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&_event_trace_rings, &p_ring->p_next, p_ring, memory_order_release, memory_order_relaxed))
+        ;
+
+    return p_ring;
+}
+
+static void _event_trace_record(_event_trace_kind_t kind, const event_t* p_event, uint_least64_t flow_id) {
+    _event_trace_ring_t* p_ring = _event_trace_get_ring();
+    if (!p_ring)
+        return;
+
+    size_t head = atomic_load_explicit(&p_ring->head, memory_order_relaxed);
+    _event_trace_record_t* p_record = &p_ring->records[head & (EVENT_TRACE_RING_SIZE - 1)];
+
+    atomic_store_explicit(&p_record->ts_ns, _event_now_ns(), memory_order_relaxed);
+    atomic_store_explicit(&p_record->flow_id, flow_id, memory_order_relaxed);
+    atomic_store_explicit(&p_record->p_event, p_event, memory_order_relaxed);
+    atomic_store_explicit(&p_record->event_name, p_event ? atomic_load_explicit(&p_event->name, memory_order_relaxed) : NULL, memory_order_relaxed);
+    atomic_store_explicit(&p_record->kind, kind, memory_order_relaxed);
+    atomic_store_explicit(&p_ring->head, head + 1, memory_order_release);
+}
+
+#define EVENT_TRACE(kind, p_event, flow_id) _event_trace_record(kind, p_event, flow_id)
+#define EVENT_TRACE_NEW_FLOW(p_event) ((p_event)->trace_flow_id = atomic_fetch_add_explicit(&_event_trace_next_flow_id, 1, memory_order_relaxed))
+#define EVENT_TRACE_FLOW(p_event) ((p_event)->trace_flow_id)
+#else
+#define EVENT_TRACE(kind, p_event, flow_id) ((void)(flow_id))
+#define EVENT_TRACE_NEW_FLOW(p_event) 0
+#define EVENT_TRACE_FLOW(p_event) 0
+#endif
+
+#ifdef EVENTS_METRICS
+static _event_counters_t _event_metrics_global;
+static atomic_uint_least64_t _event_metrics_helpers;
+
+// Named events, exported individually. Guarded by _event_names_mtx.
+static event_t* _event_metrics_events;
+
+static void _event_counters_wait(_event_counters_t* p_counters, uint_least64_t wait_ns, bool timed_out) {
+    size_t bucket = 0;
+    for (uint_least64_t bound = 1000; bucket < EVENT_METRICS_BUCKETS - 1 && wait_ns > bound; bound *= 10)
+        ++bucket;
+
+    atomic_fetch_add_explicit(&p_counters->waits, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&p_counters->wait_ns, wait_ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&p_counters->wait_buckets[bucket], 1, memory_order_relaxed);
+    if (timed_out)
+        atomic_fetch_add_explicit(&p_counters->timeouts, 1, memory_order_relaxed);
+}
+
+static void _event_metrics_wait(event_t* p_event, uint_least64_t start_ns, bool timed_out) {
+    uint_least64_t wait_ns = _event_now_ns() - start_ns;
+
+    _event_counters_wait(&_event_metrics_global, wait_ns, timed_out);
+    if (p_event)
+        _event_counters_wait(&p_event->counters, wait_ns, timed_out);
+}
+
+static void _event_metrics_retire(event_t* p_event) {
+    const char* name = atomic_load_explicit(&p_event->name, memory_order_relaxed);
+    if (!name)
+        return;
+
+    _event_counters_t* p_retired = &((_event_name_t*)(name - offsetof(_event_name_t, name)))->retired;
+    _event_counters_t* p_counters = &p_event->counters;
+
+    atomic_fetch_add_explicit(&p_retired->signals, atomic_exchange_explicit(&p_counters->signals, 0, memory_order_relaxed), memory_order_relaxed);
+    atomic_fetch_add_explicit(&p_retired->waits, atomic_exchange_explicit(&p_counters->waits, 0, memory_order_relaxed), memory_order_relaxed);
+    atomic_fetch_add_explicit(&p_retired->timeouts, atomic_exchange_explicit(&p_counters->timeouts, 0, memory_order_relaxed), memory_order_relaxed);
+    atomic_fetch_add_explicit(&p_retired->contended, atomic_exchange_explicit(&p_counters->contended, 0, memory_order_relaxed), memory_order_relaxed);
+    atomic_fetch_add_explicit(&p_retired->wait_ns, atomic_exchange_explicit(&p_counters->wait_ns, 0, memory_order_relaxed), memory_order_relaxed);
+    for (size_t i = 0; i < EVENT_METRICS_BUCKETS; ++i)
+        atomic_fetch_add_explicit(&p_retired->wait_buckets[i], atomic_exchange_explicit(&p_counters->wait_buckets[i], 0, memory_order_relaxed), memory_order_relaxed);
+}
+
+// Rename a named event, moving its counters so far to the old name, and export it from now on.
+static void _event_metrics_rename(event_t* p_event, const char* name) {
+    call_once(&_event_names_once, _event_names_init);
+    CHECK_THRD_ERR(mtx_lock(&_event_names_mtx));
+
+    _event_metrics_retire(p_event);
+    atomic_store_explicit(&p_event->name, name, memory_order_relaxed);
+
+    if (name && !p_event->metrics_registered) {
+        p_event->p_metrics_prev = NULL;
+        p_event->p_metrics_next = _event_metrics_events;
+        if (_event_metrics_events)
+            _event_metrics_events->p_metrics_prev = p_event;
+        _event_metrics_events = p_event;
+        p_event->metrics_registered = true;
+    }
+
+    CHECK_THRD_ERR(mtx_unlock(&_event_names_mtx));
+}
+
+static void _event_metrics_unregister(event_t* p_event) {
+    if (!p_event->metrics_registered)
+        return;
+
+    CHECK_THRD_ERR(mtx_lock(&_event_names_mtx));
+
+    _event_metrics_retire(p_event);
+
+    if (p_event->p_metrics_prev)
+        p_event->p_metrics_prev->p_metrics_next = p_event->p_metrics_next;
+    else
+        _event_metrics_events = p_event->p_metrics_next;
+
+    if (p_event->p_metrics_next)
+        p_event->p_metrics_next->p_metrics_prev = p_event->p_metrics_prev;
+
+    p_event->metrics_registered = false;
+
+    CHECK_THRD_ERR(mtx_unlock(&_event_names_mtx));
+}
+
+#define EVENT_METRICS_INC(p_event, counter)                                                                  \
+    do {                                                                                                     \
+        atomic_fetch_add_explicit(&_event_metrics_global.counter, 1, memory_order_relaxed);                  \
+        atomic_fetch_add_explicit(&(p_event)->counters.counter, 1, memory_order_relaxed);                    \
+    } while (0)
+#define EVENT_METRICS_WAIT_BEGIN() uint_least64_t _metrics_start_ns = _event_now_ns()
+#define EVENT_METRICS_WAIT_END(p_event, timed_out) _event_metrics_wait(p_event, _metrics_start_ns, timed_out)
+#define EVENT_METRICS_HELPER_SPAWNED() atomic_fetch_add_explicit(&_event_metrics_helpers, 1, memory_order_relaxed)
+#else
+#define EVENT_METRICS_INC(p_event, counter) ((void)0)
+#define EVENT_METRICS_WAIT_BEGIN() ((void)0)
+#define EVENT_METRICS_WAIT_END(p_event, timed_out) ((void)0)
+#define EVENT_METRICS_HELPER_SPAWNED() ((void)0)
+#endif
+
+#ifdef EVENTS_WATCHDOG
+// Events recorded per blocked wait; event_wait_multiple beyond this only reports the first ones.
+#define EVENT_WATCHDOG_MAX_EVENTS 8
+
+// One slot per waiting thread, written only by its owner under a sequence lock. Slots are never freed so that
+// scanners can read them while their threads exit. Scanners never dereference the event pointers in them: a waiter may
+// return and free its event at any time.
+typedef struct _event_blocked_t {
+    struct _event_blocked_t* p_next;
+    unsigned long thread_id;
+    atomic_uint seq;
+    atomic_size_t c_events;
+    atomic_bool wait_all;
+    atomic_uint_least64_t start_ns;
+    _Atomic(const event_t*) p_events[EVENT_WATCHDOG_MAX_EVENTS];
+    _Atomic(const char*) names[EVENT_WATCHDOG_MAX_EVENTS];
+} _event_blocked_t;
+
+static _Atomic(_event_blocked_t*) _event_blocked_slots;
+static _Thread_local bool _event_blocked_ignore;
+
+// Entries of the last signaler table. Power of 2.
+#define EVENT_WATCHDOG_SIGNALERS 1024
+
+// Last signaling thread of an event, in a table keyed by event address so that scanners can look it up without
+// touching the event. Events hashing to the same entry overwrite each other, making the signaler unknown.
+typedef struct _event_signaler_t {
+    // Odd while a signaler writes the entry.
+    atomic_uint seq;
+    _Atomic(const event_t*) p_event;
+    atomic_ulong thread_id;
+} _event_signaler_t;
+
+static _event_signaler_t _event_signalers[EVENT_WATCHDOG_SIGNALERS];
+
+static inline _event_signaler_t* _event_signaler_entry(const event_t* p_event) {
+    return &_event_signalers[(((uintptr_t)p_event >> 4) * 0x9E3779B1u) % EVENT_WATCHDOG_SIGNALERS];
+}
+
+// Record 'thread_id' as the last signaler of 'p_event'. A thread_id of 0 forgets the event if it owns the entry.
+static void _event_signaler_record(const event_t* p_event, unsigned long thread_id) {
+    _event_signaler_t* p_entry = _event_signaler_entry(p_event);
+    unsigned seq = atomic_load_explicit(&p_entry->seq, memory_order_relaxed);
+
+    for (;;) {
+        if (seq & 1)
+            seq = atomic_load_explicit(&p_entry->seq, memory_order_relaxed);
+        else if (atomic_compare_exchange_weak_explicit(&p_entry->seq, &seq, seq + 1, memory_order_acquire, memory_order_relaxed))
+            break;
+    }
+
+    if (thread_id) {
+        atomic_store_explicit(&p_entry->p_event, p_event, memory_order_relaxed);
+        atomic_store_explicit(&p_entry->thread_id, thread_id, memory_order_relaxed);
+    } else if (atomic_load_explicit(&p_entry->p_event, memory_order_relaxed) == p_event) {
+        atomic_store_explicit(&p_entry->p_event, NULL, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&p_entry->seq, seq + 2, memory_order_release);
+}
+
+// Get the last signaler of 'p_event', or 0 if unknown. Only compares the address.
+static unsigned long _event_signaler_get(const event_t* p_event) {
+    _event_signaler_t* p_entry = _event_signaler_entry(p_event);
+    unsigned seq;
+    unsigned long thread_id;
+
+    do {
+        while ((seq = atomic_load_explicit(&p_entry->seq, memory_order_acquire)) & 1)
+            thrd_yield();
+
+        thread_id = atomic_load_explicit(&p_entry->p_event, memory_order_relaxed) == p_event ? atomic_load_explicit(&p_entry->thread_id, memory_order_relaxed) : 0;
+
+        atomic_thread_fence(memory_order_acquire);
+    } while (atomic_load_explicit(&p_entry->seq, memory_order_relaxed) != seq);
+
+    return thread_id;
+}
+
+static _event_blocked_t* _event_blocked_get_slot(void) {
+    static _Thread_local _event_blocked_t* p_slot;
+    static _Thread_local bool alloc_failed;
+
+    if (p_slot || alloc_failed || _event_blocked_ignore)
+        return p_slot;
+
+    if (!(p_slot = calloc(1, sizeof(_event_blocked_t)))) {
+        alloc_failed = true;
+        return NULL;
+    }
+
+    p_slot->thread_id = _event_thread_id();
+    p_slot->p_next = atomic_load_explicit(&_event_blocked_slots, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&_event_blocked_slots, &p_slot->p_next, p_slot, memory_order_release, memory_order_relaxed))
+        ;
+
+    return p_slot;
+}
+
+static _event_blocked_t* _event_blocked_begin(event_t* const* p_events, size_t c_events, bool wait_all) {
+    _event_blocked_t* p_slot = _event_blocked_get_slot();
+    if (!p_slot)
+        return NULL;
+
+    unsigned seq = atomic_load_explicit(&p_slot->seq, memory_order_relaxed);
+    atomic_store_explicit(&p_slot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    for (size_t i = 0; i < c_events && i < EVENT_WATCHDOG_MAX_EVENTS; ++i) {
+        atomic_store_explicit(&p_slot->p_events[i], p_events[i], memory_order_relaxed);
+        atomic_store_explicit(&p_slot->names[i], p_events[i] ? atomic_load_explicit(&p_events[i]->name, memory_order_relaxed) : NULL, memory_order_relaxed);
+    }
+    atomic_store_explicit(&p_slot->c_events, c_events, memory_order_relaxed);
+    atomic_store_explicit(&p_slot->wait_all, wait_all, memory_order_relaxed);
+    atomic_store_explicit(&p_slot->start_ns, _event_now_ns(), memory_order_relaxed);
+
+    atomic_store_explicit(&p_slot->seq, seq + 2, memory_order_release);
+    return p_slot;
+}
+
+static void _event_blocked_end(_event_blocked_t* p_slot) {
+    if (!p_slot)
+        return;
+
+    unsigned seq = atomic_load_explicit(&p_slot->seq, memory_order_relaxed);
+    atomic_store_explicit(&p_slot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&p_slot->c_events, 0, memory_order_relaxed);
+    atomic_store_explicit(&p_slot->seq, seq + 2, memory_order_release);
+}
+
+#define EVENT_BLOCKED_BEGIN(p_events, c_events, wait_all) _event_blocked_t* _p_blocked_slot = _event_blocked_begin(p_events, c_events, wait_all)
+#define EVENT_BLOCKED_END() _event_blocked_end(_p_blocked_slot)
+#else
+#define EVENT_BLOCKED_BEGIN(p_events, c_events, wait_all) ((void)0)
+#define EVENT_BLOCKED_END() ((void)0)
+#endif
+
+#ifdef EVENTS_FAULT_INJECTION
+typedef struct _event_fault_config_t {
+    atomic_uint_least32_t probability_ppm;
+    atomic_uint_least64_t min_delay_ns;
+    atomic_uint_least64_t max_delay_ns;
+    atomic_uint_least64_t count;
+} _event_fault_config_t;
+
+static _event_fault_config_t _event_faults[EVENT_FAULT_POINT_COUNT];
+
+// xorshift64*, seeded per thread. Quality only matters to spread injections, not for anything security related.
+static uint_least64_t _event_fault_random(void) {
+    static _Thread_local uint_least64_t state;
+
+    if (!state)
+        state = (_event_now_ns() ^ ((uint_least64_t)_event_thread_id() << 32)) | 1;
+
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1Du;
+}
+
+static void _event_fault(event_fault_point_t point) {
+    _event_fault_config_t* p_fault = &_event_faults[point];
+    uint_least32_t probability_ppm = atomic_load_explicit(&p_fault->probability_ppm, memory_order_relaxed);
+
+    if (!probability_ppm || _event_fault_random() % 1000000u >= probability_ppm)
+        return;
+
+    uint_least64_t min_delay_ns = atomic_load_explicit(&p_fault->min_delay_ns, memory_order_relaxed);
+    uint_least64_t max_delay_ns = atomic_load_explicit(&p_fault->max_delay_ns, memory_order_relaxed);
+
+    atomic_fetch_add_explicit(&p_fault->count, 1, memory_order_relaxed);
+
+    if (!max_delay_ns) {
+        thrd_yield();
+        return;
+    }
+
+    uint_least64_t delay_ns = min_delay_ns;
+    if (max_delay_ns > min_delay_ns)
+        delay_ns += _event_fault_random() % (max_delay_ns - min_delay_ns + 1);
+
+    thrd_sleep(&(struct timespec){.tv_sec = (time_t)(delay_ns / 1000000000u), .tv_nsec = (long)(delay_ns % 1000000000u)}, NULL);
+}
+
+#define EVENT_FAULT(point) _event_fault(point)
+#else
+#define EVENT_FAULT(point) ((void)0)
+#endif
+
+// Lock the event mutex, counting contended acquisitions when metrics are enabled.
+static inline int _event_lock(event_t* p_event) {
+#ifdef EVENTS_METRICS
+    int thrd_status = _event_mtx_trylock(&p_event->mtx);
+    if (thrd_status != thrd_busy)
+        return thrd_status;
+
+    EVENT_METRICS_INC(p_event, contended);
+#endif
+    return _event_mtx_lock(&p_event->mtx);
+}
+
+static int _event_wait_helper(_event_waiter_t* p_waiter) {
+    event_t* p_event = p_waiter->p_event;
+    _event_wait_info_t* p_wait_info = p_waiter->p_wait_info;
+    bool signaled = false;
+    int thrd_status;
+    int thrd_status_2;
+
+    EVENT_PROBE1(helper__start, p_event);
+    EVENT_FAULT(EVENT_FAULT_HELPER);
+
+    if ((thrd_status = _event_lock(p_event)) == thrd_success) {
+        // 'canceled' is written under the event mutex. Taking the wait info mutex here instead would invert the
+        // lock order of event_wait_multiple, which holds it while locking events. It is checked before the first wait
+        // too, since the caller may cancel before this thread gets to lock the event.
+        while (!p_waiter->canceled && !(signaled = p_event->signaled)) {
+            if ((thrd_status = _event_cnd_wait(&p_event->cnd, &p_event->mtx)) != thrd_success)
+                break;
+        }
+
+        thrd_status_2 = _event_mtx_unlock(&p_event->mtx);
+        if (thrd_status == thrd_success)
+            thrd_status = thrd_status_2;
+    }
+
+    EVENT_FAULT(EVENT_FAULT_HELPER);
+
+    CHECK_THRD_ERR(_event_mtx_lock(&p_wait_info->mtx));
+
+    p_waiter->done = true;
+
+    CHECK_THRD_ERR(_event_cnd_signal(&p_wait_info->cnd));
+    CHECK_THRD_ERR(_event_mtx_unlock(&p_wait_info->mtx));
+
+    EVENT_PROBE2(helper__exit, p_event, signaled);
+
+    if (thrd_status != thrd_success)
+        return _thrd_status_to_errno(thrd_status);
+
+    if (!signaled)
+        return ECANCELED;
+
+    return 0;
+}
+
+#ifdef EVENTS_HAVE_PTHREAD
+#ifdef EVENTS_HAVE_HELPER_STACKS
+// Helpers only need a few hundred bytes of stack, plus the static TLS and thread descriptor pthreads places on it.
+// Running them on small cached stacks saves mapping the default of several megabytes per helper.
+#define EVENT_HELPER_STACK_SIZE (64 * 1024)
+// Idle stacks kept for reuse unless event_reserve_helper_stacks asked for more.
+#define EVENT_HELPER_STACK_CACHE 64
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#ifndef MAP_STACK
+#define MAP_STACK 0
+#endif
+
+// Header written over the bottom of an idle stack.
+typedef struct _event_stack_t {
+    struct _event_stack_t* p_next;
+} _event_stack_t;
+
+static once_flag _event_stacks_once = ONCE_FLAG_INIT;
+static mtx_t _event_stacks_mtx;
+static _event_stack_t* _event_stacks;
+static size_t _event_c_stacks;
+static size_t _event_stacks_max = EVENT_HELPER_STACK_CACHE;
+// Inaccessible page below each stack, so that an overflow faults instead of overwriting other memory. Static TLS is
+// carved out of the stack, so a process with a lot of it leaves helpers little room.
+static size_t _event_stack_guard;
+
+static void _event_stacks_init(void) {
+    CHECK_THRD_ERR(mtx_init(&_event_stacks_mtx, mtx_plain));
+
+    long page_size = sysconf(_SC_PAGESIZE);
+    _event_stack_guard = page_size > 0 ? (size_t)page_size : 4096;
+}
+
+// Map a stack with its guard page. Returns the usable bottom of the stack, or null.
+static void* _event_stack_map(void) {
+    unsigned char* p_map = mmap(NULL, _event_stack_guard + EVENT_HELPER_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (p_map == MAP_FAILED)
+        return NULL;
+
+    if (mprotect(p_map, _event_stack_guard, PROT_NONE)) {
+        munmap(p_map, _event_stack_guard + EVENT_HELPER_STACK_SIZE);
+        return NULL;
+    }
+
+    return p_map + _event_stack_guard;
+}
+
+static void _event_stack_unmap(void* p_stack) {
+    munmap((unsigned char*)p_stack - _event_stack_guard, _event_stack_guard + EVENT_HELPER_STACK_SIZE);
+}
+
+static void* _event_stack_get(void) {
+    _event_stack_t* p_stack;
+
+    call_once(&_event_stacks_once, _event_stacks_init);
+    CHECK_THRD_ERR(mtx_lock(&_event_stacks_mtx));
+
+    if ((p_stack = _event_stacks)) {
+        _event_stacks = p_stack->p_next;
+        --_event_c_stacks;
+    }
+
+    CHECK_THRD_ERR(mtx_unlock(&_event_stacks_mtx));
+    return p_stack ? (void*)p_stack : _event_stack_map();
+}
+
+// Most resident bytes among the cached stacks.
+static size_t _event_stacks_resident(void) {
+    unsigned char pages[EVENT_HELPER_STACK_SIZE / 4096];
+    size_t c_pages = EVENT_HELPER_STACK_SIZE / _event_stack_guard;
+    size_t max_bytes = 0;
+
+    CHECK_THRD_ERR(mtx_lock(&_event_stacks_mtx));
+
+    for (_event_stack_t* p_stack = _event_stacks; p_stack; p_stack = p_stack->p_next) {
+        size_t c_resident = 0;
+
+        if (c_pages > sizeof(pages) || mincore(p_stack, EVENT_HELPER_STACK_SIZE, (void*)pages))
+            break;
+
+        for (size_t i = 0; i < c_pages; ++i)
+            c_resident += pages[i] & 1;
+
+        if (c_resident * _event_stack_guard > max_bytes)
+            max_bytes = c_resident * _event_stack_guard;
+    }
+
+    CHECK_THRD_ERR(mtx_unlock(&_event_stacks_mtx));
+    return max_bytes;
+}
+
+// Only call once the thread that ran on 'p_stack' was joined.
+static void _event_stack_put(void* p_stack) {
+    CHECK_THRD_ERR(mtx_lock(&_event_stacks_mtx));
+
+    if (_event_c_stacks < _event_stacks_max) {
+        ((_event_stack_t*)p_stack)->p_next = _event_stacks;
+        _event_stacks = p_stack;
+        ++_event_c_stacks;
+        p_stack = NULL;
+    }
+
+    CHECK_THRD_ERR(mtx_unlock(&_event_stacks_mtx));
+    if (p_stack)
+        _event_stack_unmap(p_stack);
+}
+#endif
+
+static void* _event_wait_helper_start(void* p_waiter) {
+    ((_event_waiter_t*)p_waiter)->result = _event_wait_helper(p_waiter);
+    return NULL;
+}
+#endif
+
+// Start the helper thread of 'p_waiter'. Returns a thrd_ status.
+static int _event_helper_create(_event_waiter_t* p_waiter) {
+#ifdef EVENTS_HAVE_PTHREAD
+    int err = ENOMEM;
+
+#ifdef EVENTS_HAVE_HELPER_STACKS
+    pthread_attr_t attr;
+
+    if ((p_waiter->p_stack = _event_stack_get())) {
+        if (!(err = pthread_attr_init(&attr))) {
+            if (!(err = pthread_attr_setstack(&attr, p_waiter->p_stack, EVENT_HELPER_STACK_SIZE)))
+                err = pthread_create(&p_waiter->thrd, &attr, _event_wait_helper_start, p_waiter);
+
+            pthread_attr_destroy(&attr);
+        }
+
+        if (!err)
+            return thrd_success;
+
+        _event_stack_put(p_waiter->p_stack);
+        p_waiter->p_stack = NULL;
+    }
+#endif
+
+    // The process' static TLS may not fit a small stack. Fall back to the default stack rather than fail the wait.
+    if (err != EAGAIN)
+        err = pthread_create(&p_waiter->thrd, NULL, _event_wait_helper_start, p_waiter);
+
+    return !err ? thrd_success : err == ENOMEM ? thrd_nomem : thrd_error;
+#else
+    return thrd_create(&p_waiter->thrd, (thrd_start_t)_event_wait_helper, p_waiter);
+#endif
+}
+
+// Join the helper thread of 'p_waiter' and store its result in '*p_result' unless it is null. Returns a thrd_ status.
+static int _event_helper_join(_event_waiter_t* p_waiter, int* p_result) {
+#ifdef EVENTS_HAVE_PTHREAD
+    if (pthread_join(p_waiter->thrd, NULL))
+        return thrd_error;
+
+#ifdef EVENTS_HAVE_HELPER_STACKS
+    if (p_waiter->p_stack) {
+        _event_stack_put(p_waiter->p_stack);
+        p_waiter->p_stack = NULL;
+    }
+#endif
+
+    if (p_result)
+        *p_result = p_waiter->result;
+
+    return thrd_success;
+#else
+    return thrd_join(p_waiter->thrd, p_result);
+#endif
+}
+
+event_error_t event_reserve_helper_stacks(size_t c_stacks) {
+#ifdef EVENTS_HAVE_HELPER_STACKS
+    call_once(&_event_stacks_once, _event_stacks_init);
+    CHECK_THRD_ERR(mtx_lock(&_event_stacks_mtx));
+
+    event_error_t err = 0;
+
+    if (c_stacks > _event_stacks_max)
+        _event_stacks_max = c_stacks;
+
+    while (_event_c_stacks < c_stacks) {
+        _event_stack_t* p_stack = _event_stack_map();
+        if (!p_stack) {
+            err = ENOMEM;
+            break;
+        }
+
+        p_stack->p_next = _event_stacks;
+        _event_stacks = p_stack;
+        ++_event_c_stacks;
+    }
+
+    CHECK_THRD_ERR(mtx_unlock(&_event_stacks_mtx));
+    return err;
+#else
+    (void)c_stacks;
+    return ENOTSUP;
+#endif
+}
+
+size_t event_get_size(void) {
+    return sizeof(event_t);
+}
+
+event_error_t event_get_footprint(event_footprint_t* p_footprint) {
+    if (!p_footprint)
+        return EINVAL;
+
+    memset(p_footprint, 0, sizeof(*p_footprint));
+    p_footprint->backend = _EVENT_BACKEND_NAME;
+    p_footprint->event_bytes = sizeof(event_t);
+    p_footprint->name_bytes = sizeof(_event_name_t);
+    p_footprint->wait_multiple_bytes = sizeof(_event_waiter_t);
+    p_footprint->wait_all_bytes = sizeof(event_t*);
+#ifdef EVENTS_HAVE_HELPER_STACKS
+    call_once(&_event_stacks_once, _event_stacks_init);
+    p_footprint->helper_stack_bytes = _event_stack_guard + EVENT_HELPER_STACK_SIZE;
+    p_footprint->helper_resident_bytes = _event_stacks_resident();
+#endif
+#ifdef EVENTS_TRACE
+    p_footprint->thread_bytes += sizeof(_event_trace_ring_t);
+#endif
+#ifdef EVENTS_WATCHDOG
+    p_footprint->thread_bytes += sizeof(_event_blocked_t);
+    p_footprint->static_bytes += sizeof(_event_signalers);
+#endif
+#ifdef EVENTS_PROFILE
+    p_footprint->static_bytes += sizeof(_event_profile_sites) + sizeof(_event_profile_phases);
+#endif
+#ifdef EVENTS_METRICS
+    p_footprint->static_bytes += sizeof(_event_metrics_global) + sizeof(_event_metrics_helpers);
+#endif
+#ifdef EVENTS_FAULT_INJECTION
+    p_footprint->static_bytes += sizeof(_event_faults);
+#endif
+    return 0;
+}
+
+event_error_t event_init(event_t* p_event, bool is_manual_reset, bool initial_state) {
+    if (!p_event)
+        return EINVAL;
+
+    int thrd_status;
+
+    if ((thrd_status = _event_mtx_init(&p_event->mtx)) == thrd_success) {
+        if ((thrd_status = _event_cnd_init(&p_event->cnd)) == thrd_success) {
+            p_event->signaled = initial_state;
+            p_event->is_manual_reset = is_manual_reset;
+            p_event->c_generation_waiters = 0;
+            atomic_init(&p_event->generation, 0);
+            atomic_init(&p_event->name, NULL);
+#ifdef EVENTS_METRICS
+            memset(&p_event->counters, 0, sizeof(p_event->counters));
+            p_event->metrics_registered = false;
+#endif
+            return 0;
+        }
+
+        _event_mtx_destroy(&p_event->mtx);
+    }
+
+    return _thrd_status_to_errno(thrd_status);
+}
+
+void event_destroy(event_t* p_event) {
+    if (p_event) {
+#ifdef EVENTS_METRICS
+        _event_metrics_unregister(p_event);
+#endif
+#ifdef EVENTS_WATCHDOG
+        // A later event at the same address must not inherit the last signaler.
+        _event_signaler_record(p_event, 0);
+#endif
+        _event_cnd_destroy(&p_event->cnd);
+        _event_mtx_destroy(&p_event->mtx);
+    }
+}
+
+event_error_t event_set_name(event_t* p_event, const char* name) {
+    if (!p_event)
+        return EINVAL;
+
+    const char* p_interned = NULL;
+
+    if (name && *name && !(p_interned = _event_intern_name(name)))
+        return ENOMEM;
+
+#ifdef EVENTS_METRICS
+    _event_metrics_rename(p_event, p_interned);
+#else
+    atomic_store_explicit(&p_event->name, p_interned, memory_order_relaxed);
+#endif
+    return 0;
+}
+
+const char* event_get_name(const event_t* p_event) {
+    if (!p_event)
+        return NULL;
+
+    return atomic_load_explicit(&((event_t*)p_event)->name, memory_order_relaxed);
+}
+
+unsigned long event_get_thread_id(void) {
+    return _event_thread_id();
+}
+
+event_error_t event_signal(event_t* p_event) {
+    if (!p_event)
+        return EINVAL;
+
+    int thrd_status;
+    int thrd_status_2;
+
+    if ((thrd_status = _event_lock(p_event)) == thrd_success) {
+        p_event->signaled = true;
+        atomic_store_explicit(&p_event->generation, atomic_load_explicit(&p_event->generation, memory_order_relaxed) + 1, memory_order_release);
+        EVENT_PROBE2(signal, p_event, p_event->is_manual_reset);
+        EVENT_METRICS_INC(p_event, signals);
+#ifdef EVENTS_WATCHDOG
+        _event_signaler_record(p_event, _event_thread_id());
+#endif
+        EVENT_TRACE(_EVENT_TRACE_SIGNAL, p_event, EVENT_TRACE_NEW_FLOW(p_event));
+        EVENT_FAULT(EVENT_FAULT_SIGNAL);
+        // A single wake could go to a generation waiter and be lost to the others.
+        if (p_event->is_manual_reset || p_event->c_generation_waiters)
+            thrd_status = _event_cnd_broadcast(&p_event->cnd);
+        else
+            thrd_status = _event_cnd_signal(&p_event->cnd);
+        thrd_status_2 = _event_mtx_unlock(&p_event->mtx);
+        if (thrd_status == thrd_success)
+            thrd_status = thrd_status_2;
+    }
+
+    return _thrd_status_to_errno(thrd_status);
+}
+
+event_error_t event_reset(event_t* p_event) {
+    if (!p_event)
+        return EINVAL;
+
+    int thrd_status;
+
+    if ((thrd_status = _event_lock(p_event)) == thrd_success) {
+        p_event->signaled = false;
+        thrd_status = _event_mtx_unlock(&p_event->mtx);
+    }
+
+    EVENT_TRACE(_EVENT_TRACE_RESET, p_event, 0);
+
+    return _thrd_status_to_errno(thrd_status);
+}
+
+event_error_t event_pulse(event_t* p_event) {
+    event_error_t err;
+    if (!(err = event_signal(p_event)))
+        err = event_reset(p_event);
+    return err;
+}
+
+static event_error_t _event_wait(event_t* p_event, const struct timespec* p_time, const void* caller) {
+    if (!p_event)
+        return EINVAL;
+
+    int thrd_status;
+    int thrd_status_2;
+    uint_least64_t trace_flow_id = 0;
+
+    EVENT_PROBE1(wait__entry, p_event);
+    EVENT_PROFILE_BEGIN();
+    EVENT_METRICS_WAIT_BEGIN();
+    EVENT_BLOCKED_BEGIN(&p_event, 1, false);
+    EVENT_TRACE(_EVENT_TRACE_WAIT_BEGIN, p_event, 0);
+    EVENT_FAULT(EVENT_FAULT_WAIT);
+
+    if ((thrd_status = _event_lock(p_event)) == thrd_success) {
+        do {
+            if (p_event->signaled) {
+                if (!p_event->is_manual_reset)
+                    p_event->signaled = false;
+                trace_flow_id = EVENT_TRACE_FLOW(p_event);
+                break;
+            }
+
+            EVENT_PROBE1(wait__block, p_event);
+        } while ((thrd_status = p_time ? _event_cnd_timedwait(&p_event->cnd, &p_event->mtx, p_time) : _event_cnd_wait(&p_event->cnd, &p_event->mtx)) == thrd_success);
+
+        thrd_status_2 = _event_mtx_unlock(&p_event->mtx);
+        if (thrd_status == thrd_success)
+            thrd_status = thrd_status_2;
+    }
+
+    EVENT_FAULT(EVENT_FAULT_WAKE);
+
+    if (thrd_status == thrd_timedout)
+        EVENT_TRACE(_EVENT_TRACE_TIMEOUT, p_event, 0);
+    EVENT_TRACE(_EVENT_TRACE_WAIT_END, p_event, trace_flow_id);
+    EVENT_BLOCKED_END();
+    EVENT_METRICS_WAIT_END(p_event, thrd_status == thrd_timedout);
+    EVENT_PROFILE_END(caller, p_event);
+
+    event_error_t err = _thrd_status_to_errno(thrd_status);
+    EVENT_PROBE2(wait__return, p_event, err);
+    return err;
+}
+
+event_error_t event_wait(event_t* p_event, const struct timespec* p_time) {
+    return _event_wait(p_event, p_time, _EVENT_CALLER());
+}
+
+// Wait with the event locked until a signal advances its generation past 'generation'.
+static int _event_wait_generation(event_t* p_event, uint_least64_t generation, const struct timespec* p_time) {
+    int thrd_status = thrd_success;
+
+    while (atomic_load_explicit(&p_event->generation, memory_order_relaxed) == generation) {
+        EVENT_PROBE1(wait__block, p_event);
+        if ((thrd_status = p_time ? _event_cnd_timedwait(&p_event->cnd, &p_event->mtx, p_time) : _event_cnd_wait(&p_event->cnd, &p_event->mtx)) != thrd_success)
+            break;
+    }
+
+    return thrd_status;
+}
+
+event_error_t event_wait_until(event_t* p_event, bool (*predicate)(void* ctx), void* ctx, const struct timespec* p_time) {
+    if (!p_event || !predicate)
+        return EINVAL;
+
+    if (predicate(ctx))
+        return 0;
+
+    int thrd_status;
+    int thrd_status_2;
+
+    EVENT_PROBE1(wait__entry, p_event);
+    EVENT_PROFILE_BEGIN();
+    EVENT_METRICS_WAIT_BEGIN();
+    EVENT_BLOCKED_BEGIN(&p_event, 1, false);
+    EVENT_TRACE(_EVENT_TRACE_WAIT_BEGIN, p_event, 0);
+    EVENT_FAULT(EVENT_FAULT_WAIT);
+
+    if ((thrd_status = _event_lock(p_event)) == thrd_success) {
+        ++p_event->c_generation_waiters;
+
+        // Signalers take the event lock after making the predicate true, so checking it under the lock and then
+        // waiting for the generation to advance cannot miss a wake.
+        while (!predicate(ctx)) {
+            uint_least64_t generation = atomic_load_explicit(&p_event->generation, memory_order_relaxed);
+            if ((thrd_status = _event_wait_generation(p_event, generation, p_time)) != thrd_success)
+                break;
+        }
+
+        // The predicate may have become true just as time expired.
+        if (thrd_status == thrd_timedout && predicate(ctx))
+            thrd_status = thrd_success;
+
+        --p_event->c_generation_waiters;
+        thrd_status_2 = _event_mtx_unlock(&p_event->mtx);
+        if (thrd_status == thrd_success)
+            thrd_status = thrd_status_2;
+    }
+
+    EVENT_FAULT(EVENT_FAULT_WAKE);
+
+    if (thrd_status == thrd_timedout)
+        EVENT_TRACE(_EVENT_TRACE_TIMEOUT, p_event, 0);
+    EVENT_TRACE(_EVENT_TRACE_WAIT_END, p_event, 0);
+    EVENT_BLOCKED_END();
+    EVENT_METRICS_WAIT_END(p_event, thrd_status == thrd_timedout);
+    EVENT_PROFILE_END(_EVENT_CALLER(), p_event);
+
+    event_error_t err = _thrd_status_to_errno(thrd_status);
+    EVENT_PROBE2(wait__return, p_event, err);
+    return err;
+}
+
+event_error_t event_get_version(const event_t* p_event, uint_least64_t* p_version) {
+    if (!p_event || !p_version)
+        return EINVAL;
+
+    *p_version = atomic_load_explicit(&((event_t*)p_event)->generation, memory_order_acquire);
+    return 0;
+}
+
+event_error_t event_wait_changed(event_t* p_event, uint_least64_t* p_last_seen_version, const struct timespec* p_time) {
+    if (!p_event || !p_last_seen_version)
+        return EINVAL;
+
+    uint_least64_t last_seen_version = *p_last_seen_version;
+    uint_least64_t version = atomic_load_explicit(&p_event->generation, memory_order_acquire);
+
+    if (version != last_seen_version) {
+        *p_last_seen_version = version;
+        return 0;
+    }
+
+    int thrd_status;
+    int thrd_status_2;
+
+    EVENT_PROBE1(wait__entry, p_event);
+    EVENT_PROFILE_BEGIN();
+    EVENT_METRICS_WAIT_BEGIN();
+    EVENT_BLOCKED_BEGIN(&p_event, 1, false);
+    EVENT_TRACE(_EVENT_TRACE_WAIT_BEGIN, p_event, 0);
+    EVENT_FAULT(EVENT_FAULT_WAIT);
+
+    if ((thrd_status = _event_lock(p_event)) == thrd_success) {
+        ++p_event->c_generation_waiters;
+        thrd_status = _event_wait_generation(p_event, last_seen_version, p_time);
+        --p_event->c_generation_waiters;
+        *p_last_seen_version = atomic_load_explicit(&p_event->generation, memory_order_relaxed);
+        thrd_status_2 = _event_mtx_unlock(&p_event->mtx);
+        if (thrd_status == thrd_success)
+            thrd_status = thrd_status_2;
+        else if (thrd_status == thrd_timedout && *p_last_seen_version != last_seen_version)
+            thrd_status = thrd_success;
+    }
+
+    EVENT_FAULT(EVENT_FAULT_WAKE);
+
+    if (thrd_status == thrd_timedout)
+        EVENT_TRACE(_EVENT_TRACE_TIMEOUT, p_event, 0);
+    EVENT_TRACE(_EVENT_TRACE_WAIT_END, p_event, 0);
+    EVENT_BLOCKED_END();
+    EVENT_METRICS_WAIT_END(p_event, thrd_status == thrd_timedout);
+    EVENT_PROFILE_END(_EVENT_CALLER(), p_event);
+
+    event_error_t err = _thrd_status_to_errno(thrd_status);
+    EVENT_PROBE2(wait__return, p_event, err);
+    return err;
+}
+
+static event_error_t _event_wait_multiple(event_t** p_events, size_t c_events, bool wait_all, const struct timespec* p_time, size_t* p_idx_signaled_event);
+
+event_error_t event_wait_multiple(event_t** p_events, size_t c_events, bool wait_all, const struct timespec* p_time, size_t* p_idx_signaled_event) {
+    if (p_idx_signaled_event)
+        *p_idx_signaled_event = 0;
+
+    if (!c_events)
+        return 0;
+
+    if (!p_events || (!wait_all && !p_idx_signaled_event))
+        return EINVAL;
+
+    if (c_events == 1)
+        return _event_wait(*p_events, p_time, _EVENT_CALLER());
+
+    event_error_t err;
+
+    EVENT_PROBE3(wait_multiple__entry, p_events, c_events, wait_all);
+    EVENT_PROFILE_BEGIN();
+    EVENT_METRICS_WAIT_BEGIN();
+    EVENT_BLOCKED_BEGIN(p_events, c_events, wait_all);
+    EVENT_TRACE(_EVENT_TRACE_WAIT_MULTIPLE_BEGIN, NULL, 0);
+    err = _event_wait_multiple(p_events, c_events, wait_all, p_time, p_idx_signaled_event);
+    if (err == ETIMEDOUT)
+        EVENT_TRACE(_EVENT_TRACE_TIMEOUT, NULL, 0);
+    EVENT_TRACE(_EVENT_TRACE_WAIT_MULTIPLE_END, NULL, 0);
+    EVENT_BLOCKED_END();
+    EVENT_METRICS_WAIT_END(NULL, err == ETIMEDOUT);
+    EVENT_PROFILE_END(_EVENT_CALLER(), NULL);
+    EVENT_PROBE2(wait_multiple__return, p_events, err);
+
+    return err;
+}
+
+static int _event_ptr_cmp(const void* p_lhs, const void* p_rhs) {
+    uintptr_t lhs = (uintptr_t)*(event_t* const*)p_lhs;
+    uintptr_t rhs = (uintptr_t)*(event_t* const*)p_rhs;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static event_error_t _event_wait_multiple(event_t** p_events, size_t c_events, bool wait_all, const struct timespec* p_time, size_t* p_idx_signaled_event) {
+    _event_waiter_t* p_waiters;
+    _event_wait_info_t wait_info;
+    int err = 0;
+    int thrd_status = thrd_success;
+    int thrd_status_2;
+    bool all_signaled;
+    event_t** p_lock_order = NULL;
+    size_t c_lock_order = 0;
+
+    EVENT_PHASE_BEGIN();
+
+    p_waiters = calloc(c_events, sizeof(_event_waiter_t));
+    if (!p_waiters)
+        return errno;
+
+    // Waiting for all events locks them together. Lock them in address order, once each, so that concurrent waits on
+    // overlapping sets cannot deadlock.
+    if (wait_all) {
+        if (!(p_lock_order = malloc(c_events * sizeof(event_t*)))) {
+            err = errno;
+            EVENT_PHASE_END(EVENT_PHASE_ALLOC);
+            goto clean_up_waiters;
+        }
+
+        memcpy(p_lock_order, p_events, c_events * sizeof(event_t*));
+        qsort(p_lock_order, c_events, sizeof(event_t*), _event_ptr_cmp);
+
+        for (size_t i = 0; i < c_events; ++i) {
+            if (!c_lock_order || p_lock_order[c_lock_order - 1] != p_lock_order[i])
+                p_lock_order[c_lock_order++] = p_lock_order[i];
+        }
+    }
+
+    EVENT_PHASE_END(EVENT_PHASE_ALLOC);
+
+    // A failed setup step is timed as its own phase, so that teardown only counts tearing down.
+    if ((thrd_status = _event_mtx_init(&wait_info.mtx)) != thrd_success) {
+        EVENT_PHASE_END(EVENT_PHASE_INIT);
+        goto clean_up_waiters;
+    }
+
+    if ((thrd_status = _event_cnd_init(&wait_info.cnd)) != thrd_success) {
+        EVENT_PHASE_END(EVENT_PHASE_INIT);
+        goto clean_up_wait_info_mtx;
+    }
+
+    EVENT_PHASE_END(EVENT_PHASE_INIT);
+
+restart_wait:
+    for (size_t i = 0; i < c_events; ++i) {
+        _event_waiter_t* p_waiter = &p_waiters[i];
+        p_waiter->p_event = p_events[i];
+        p_waiter->p_wait_info = &wait_info;
+        p_waiter->joinable = true;
+        p_waiter->canceled = false;
+        p_waiter->done = false;
+
+        if ((thrd_status = _event_helper_create(p_waiter)) != thrd_success) {
+            for (size_t j = 0; j < i; ++j)
+                _event_helper_join(&p_waiters[j], NULL);
+
+            EVENT_PHASE_END(EVENT_PHASE_SPAWN);
+            goto clean_up_wait_info_cnd;
+        }
+
+        EVENT_METRICS_HELPER_SPAWNED();
+    }
+
+    EVENT_PHASE_END(EVENT_PHASE_SPAWN);
+    EVENT_FAULT(EVENT_FAULT_WAIT_MULTIPLE);
+
+    CHECK_THRD_ERR(_event_mtx_lock(&wait_info.mtx));
+
+    if (thrd_status != thrd_success)
+        goto clean_up_threads;
+
+    do {
+        if (wait_all) {
+            all_signaled = true;
+            for (size_t i = 0; i < c_events; ++i) {
+                _event_waiter_t* p_waiter = &p_waiters[i];
+
+                if (p_waiter->done) {
+                    if (p_waiter->joinable) {
+                        thrd_status = _event_helper_join(p_waiter, &err);
+                        p_waiter->joinable = false;
+
+                        if (thrd_status != thrd_success) {
+                            err = 0;
+                            goto clean_up_threads;
+                        }
+
+                        if (err)
+                            goto clean_up_threads;
+                    }
+                } else {
+                    all_signaled = false;
+                }
+            }
+
+            if (all_signaled) {
+                size_t locked;
+                for (locked = 0; locked < c_lock_order; ++locked) {
+                    if ((thrd_status = _event_lock(p_lock_order[locked])) != thrd_success) {
+                        all_signaled = false;
+                        break;
+                    }
+
+                    if (!p_lock_order[locked]->signaled) {
+                        all_signaled = false;
+                        ++locked;
+                        break;
+                    }
+                }
+
+                thrd_status_2 = thrd_success;
+                for (size_t i = 0; i < locked; ++i) {
+                    if (all_signaled && !p_lock_order[i]->is_manual_reset)
+                        p_lock_order[i]->signaled = false;
+
+                    thrd_status_2 = _event_mtx_unlock(&p_lock_order[i]->mtx);
+                }
+
+                if (thrd_status == thrd_success)
+                    thrd_status = thrd_status_2;
+
+                goto clean_up_threads;
+            }
+        } else {
+            for (size_t i = 0; i < c_events; ++i) {
+                _event_waiter_t* p_waiter = &p_waiters[i];
+
+                if (p_waiter->done) {
+                    if (p_waiter->joinable) {
+                        thrd_status = _event_helper_join(p_waiter, &err);
+                        p_waiter->joinable = false;
+
+                        if (thrd_status != thrd_success) {
+                            err = 0;
+                            goto clean_up_threads;
+                        }
+
+                        if (err)
+                            goto clean_up_threads;
+                    }
+
+                    *p_idx_signaled_event = i;
+
+                    if (!p_events[i]->is_manual_reset && _event_lock(p_events[i]) == thrd_success) {
+                        p_events[i]->signaled = false;
+                        _event_mtx_unlock(&p_events[i]->mtx);
+                    }
+
+                    goto clean_up_threads;
+                }
+            }
+        }
+    } while ((thrd_status = p_time ? _event_cnd_timedwait(&wait_info.cnd, &wait_info.mtx, p_time) : _event_cnd_wait(&wait_info.cnd, &wait_info.mtx)) == thrd_success);
+
+clean_up_threads:
+    EVENT_PHASE_END(EVENT_PHASE_RENDEZVOUS);
+
+    for (size_t i = 0; i < c_events; ++i) {
+        _event_waiter_t* p_waiter = &p_waiters[i];
+
+        if (!p_waiter->done) {
+            event_t* p_event = p_waiters[i].p_event;
+
+            CHECK_THRD_ERR(_event_lock(p_event));
+            p_waiter->canceled = true;
+            CHECK_THRD_ERR(_event_cnd_broadcast(&p_event->cnd));
+            CHECK_THRD_ERR(_event_mtx_unlock(&p_event->mtx));
+        }
+    }
+
+    CHECK_THRD_ERR(_event_mtx_unlock(&wait_info.mtx));
+
+    EVENT_PHASE_END(EVENT_PHASE_CANCEL);
+
+    for (size_t i = 0; i < c_events; ++i) {
+        _event_waiter_t* p_waiter = &p_waiters[i];
+
+        if (p_waiter->joinable)
+            _event_helper_join(p_waiter, NULL);
+    }
+
+    EVENT_PHASE_END(EVENT_PHASE_JOIN);
+
+    if (wait_all && !err && thrd_status == thrd_success && !all_signaled)
+        goto restart_wait;
+
+clean_up_wait_info_cnd:
+    _event_cnd_destroy(&wait_info.cnd);
+
+clean_up_wait_info_mtx:
+    _event_mtx_destroy(&wait_info.mtx);
+
+clean_up_waiters:
+    free(p_lock_order);
+    free(p_waiters);
+
+    EVENT_PHASE_END(EVENT_PHASE_TEARDOWN);
+
+    if (err)
+        return err;
+
+    return _thrd_status_to_errno(thrd_status);
+}
+
+typedef struct _event_address_wait_t {
+    const volatile void* addr;
+    const void* p_expected;
+    size_t size;
+} _event_address_wait_t;
+
+// Compare with volatile loads of the exact size, so that a concurrent atomic store is never seen torn.
+static bool _event_address_unchanged(void* ctx) {
+    _event_address_wait_t* p_wait = ctx;
+
+    switch (p_wait->size) {
+        case 1:
+            return *(const volatile uint8_t*)p_wait->addr == *(const uint8_t*)p_wait->p_expected;
+        case 2:
+            return *(const volatile uint16_t*)p_wait->addr == *(const uint16_t*)p_wait->p_expected;
+        case 4:
+            return *(const volatile uint32_t*)p_wait->addr == *(const uint32_t*)p_wait->p_expected;
+        default:
+            return *(const volatile uint64_t*)p_wait->addr == *(const uint64_t*)p_wait->p_expected;
+    }
+}
+
+event_error_t event_wait_on_address(const volatile void* addr, const void* p_expected, size_t size, const struct timespec* p_time) {
+    if (!addr || !p_expected || (size != 1 && size != 2 && size != 4 && size != 8) || (uintptr_t)addr % size)
+        return EINVAL;
+
+    _event_address_wait_t wait = {addr, p_expected, size};
+    int thrd_status = _event_park((const void*)addr, _event_address_unchanged, &wait, p_time);
+
+    return thrd_status == thrd_busy ? 0 : _thrd_status_to_errno(thrd_status);
+}
+
+void event_wake_by_address_single(const void* addr) {
+    if (addr)
+        _event_unpark(addr, 1);
+}
+
+void event_wake_by_address_all(const void* addr) {
+    if (addr)
+        _event_unpark(addr, SIZE_MAX);
+}
+
+// Attempts to take a contended lock before parking, since parking and unparking cost far more than a short spin.
+#define EVENT_LOCK_SPINS 100
+
+// event_mutex_t states.
+#define _EVENT_MUTEX_UNLOCKED 0u
+#define _EVENT_MUTEX_LOCKED 1u
+// Locked, and threads may be parked on it.
+#define _EVENT_MUTEX_CONTENDED 2u
+
+void event_mutex_init(event_mutex_t* p_mutex) {
+    if (p_mutex)
+        atomic_init(&p_mutex->state, _EVENT_MUTEX_UNLOCKED);
+}
+
+event_error_t event_mutex_lock(event_mutex_t* p_mutex) {
+    return event_mutex_timedlock(p_mutex, NULL);
+}
+
+event_error_t event_mutex_timedlock(event_mutex_t* p_mutex, const struct timespec* p_time) {
+    if (!p_mutex)
+        return EINVAL;
+
+    unsigned state = _EVENT_MUTEX_UNLOCKED;
+    int thrd_status;
+
+    if (atomic_compare_exchange_strong_explicit(&p_mutex->state, &state, _EVENT_MUTEX_LOCKED, memory_order_acquire, memory_order_relaxed))
+        return 0;
+
+    for (int spin = 0; spin < EVENT_LOCK_SPINS && state == _EVENT_MUTEX_LOCKED; ++spin) {
+        state = atomic_load_explicit(&p_mutex->state, memory_order_relaxed);
+        if (state == _EVENT_MUTEX_UNLOCKED &&
+            atomic_compare_exchange_weak_explicit(&p_mutex->state, &state, _EVENT_MUTEX_LOCKED, memory_order_acquire, memory_order_relaxed))
+            return 0;
+    }
+
+    // Having parked, take the lock as contended: other threads may still be parked and unlock has to wake them.
+    while (atomic_exchange_explicit(&p_mutex->state, _EVENT_MUTEX_CONTENDED, memory_order_acquire) != _EVENT_MUTEX_UNLOCKED) {
+        // Giving up leaves the word contended, which only costs the owner an unneeded wake on unlock.
+        if ((thrd_status = _event_park_word(&p_mutex->state, _EVENT_MUTEX_CONTENDED, p_time)) != thrd_success)
+            return _thrd_status_to_errno(thrd_status);
+    }
+
+    return 0;
+}
+
+event_error_t event_mutex_trylock(event_mutex_t* p_mutex) {
+    if (!p_mutex)
+        return EINVAL;
+
+    unsigned state = _EVENT_MUTEX_UNLOCKED;
+    return atomic_compare_exchange_strong_explicit(&p_mutex->state, &state, _EVENT_MUTEX_LOCKED, memory_order_acquire, memory_order_relaxed) ? 0 : EBUSY;
+}
+
+event_error_t event_mutex_unlock(event_mutex_t* p_mutex) {
+    if (!p_mutex)
+        return EINVAL;
+
+    if (atomic_exchange_explicit(&p_mutex->state, _EVENT_MUTEX_UNLOCKED, memory_order_release) == _EVENT_MUTEX_CONTENDED)
+        _event_unpark(&p_mutex->state, 1);
+
+    return 0;
+}
+
+// Lock where giving up would leave shared state inconsistent. event_mutex_lock only fails if parking fails, and the
+// lock word stays usable, so trying again still gets the lock.
+static void _event_mutex_lock_always(event_mutex_t* p_mutex) {
+    while (event_mutex_lock(p_mutex))
+        thrd_yield();
+}
+
+// event_rwlock_t state bits. The reader count is kept above them.
+#define _EVENT_RWLOCK_WRITER 1u
+#define _EVENT_RWLOCK_WRITERS_PARKED 2u
+#define _EVENT_RWLOCK_READERS_PARKED 4u
+#define _EVENT_RWLOCK_READER 8u
+#define _EVENT_RWLOCK_READERS(state) ((state) & ~(_EVENT_RWLOCK_READER - 1))
+
+// Readers and writers park on different addresses so that each can be woken without the other.
+#define _EVENT_RWLOCK_READERS_KEY(p_rwlock) ((const void*)&(p_rwlock)->state)
+#define _EVENT_RWLOCK_WRITERS_KEY(p_rwlock) ((const void*)((const char*)&(p_rwlock)->state + 1))
+
+static bool _event_rwlock_reader_must_park(void* ctx) {
+    unsigned state = atomic_load_explicit((atomic_uint*)ctx, memory_order_relaxed);
+    return (state & _EVENT_RWLOCK_READERS_PARKED) && (state & (_EVENT_RWLOCK_WRITER | _EVENT_RWLOCK_WRITERS_PARKED));
+}
+
+static bool _event_rwlock_writer_must_park(void* ctx) {
+    unsigned state = atomic_load_explicit((atomic_uint*)ctx, memory_order_relaxed);
+    return (state & _EVENT_RWLOCK_WRITERS_PARKED) && ((state & _EVENT_RWLOCK_WRITER) || _EVENT_RWLOCK_READERS(state));
+}
+
+void event_rwlock_init(event_rwlock_t* p_rwlock) {
+    if (p_rwlock)
+        atomic_init(&p_rwlock->state, 0);
+}
+
+event_error_t event_rwlock_read_lock(event_rwlock_t* p_rwlock) {
+    if (!p_rwlock)
+        return EINVAL;
+
+    unsigned state = 0;
+    int spin = 0;
+    int thrd_status;
+
+    for (;;) {
+        if (!(state & (_EVENT_RWLOCK_WRITER | _EVENT_RWLOCK_WRITERS_PARKED))) {
+            if (atomic_compare_exchange_weak_explicit(&p_rwlock->state, &state, state + _EVENT_RWLOCK_READER, memory_order_acquire, memory_order_relaxed))
+                return 0;
+            continue;
+        }
+
+        if (spin < EVENT_LOCK_SPINS) {
+            ++spin;
+            state = atomic_load_explicit(&p_rwlock->state, memory_order_relaxed);
+            continue;
+        }
+
+        if (!(state & _EVENT_RWLOCK_READERS_PARKED) &&
+            !atomic_compare_exchange_weak_explicit(&p_rwlock->state, &state, state | _EVENT_RWLOCK_READERS_PARKED, memory_order_relaxed, memory_order_relaxed))
+            continue;
+
+        thrd_status = _event_park(_EVENT_RWLOCK_READERS_KEY(p_rwlock), _event_rwlock_reader_must_park, &p_rwlock->state, NULL);
+        if (thrd_status != thrd_success && thrd_status != thrd_busy)
+            return _thrd_status_to_errno(thrd_status);
+
+        state = atomic_load_explicit(&p_rwlock->state, memory_order_relaxed);
+    }
+}
+
+event_error_t event_rwlock_try_read_lock(event_rwlock_t* p_rwlock) {
+    if (!p_rwlock)
+        return EINVAL;
+
+    unsigned state = atomic_load_explicit(&p_rwlock->state, memory_order_relaxed);
+
+    while (!(state & (_EVENT_RWLOCK_WRITER | _EVENT_RWLOCK_WRITERS_PARKED))) {
+        if (atomic_compare_exchange_weak_explicit(&p_rwlock->state, &state, state + _EVENT_RWLOCK_READER, memory_order_acquire, memory_order_relaxed))
+            return 0;
+    }
+
+    return EBUSY;
+}
+
+event_error_t event_rwlock_read_unlock(event_rwlock_t* p_rwlock) {
+    if (!p_rwlock)
+        return EINVAL;
+
+    unsigned state = atomic_fetch_sub_explicit(&p_rwlock->state, _EVENT_RWLOCK_READER, memory_order_release) - _EVENT_RWLOCK_READER;
+
+    // The last reader out hands over to one parked writer. Parked readers wait for that writer.
+    while (!_EVENT_RWLOCK_READERS(state) && !(state & _EVENT_RWLOCK_WRITER) && (state & _EVENT_RWLOCK_WRITERS_PARKED)) {
+        if (atomic_compare_exchange_weak_explicit(&p_rwlock->state, &state, state & ~_EVENT_RWLOCK_WRITERS_PARKED, memory_order_relaxed, memory_order_relaxed)) {
+            _event_unpark(_EVENT_RWLOCK_WRITERS_KEY(p_rwlock), 1);
+            break;
+        }
+    }
+
+    return 0;
+}
+
+event_error_t event_rwlock_write_lock(event_rwlock_t* p_rwlock) {
+    if (!p_rwlock)
+        return EINVAL;
+
+    unsigned state = 0;
+    // Having parked, keep the writers parked bit set on taking the lock, so that unlock wakes the next writer.
+    unsigned parked = 0;
+    int spin = 0;
+    int thrd_status;
+
+    for (;;) {
+        if (!(state & _EVENT_RWLOCK_WRITER) && !_EVENT_RWLOCK_READERS(state)) {
+            if (atomic_compare_exchange_weak_explicit(&p_rwlock->state, &state, state | _EVENT_RWLOCK_WRITER | parked, memory_order_acquire, memory_order_relaxed))
+                return 0;
+            continue;
+        }
+
+        if (spin < EVENT_LOCK_SPINS) {
+            ++spin;
+            state = atomic_load_explicit(&p_rwlock->state, memory_order_relaxed);
+            continue;
+        }
+
+        if (!(state & _EVENT_RWLOCK_WRITERS_PARKED) &&
+            !atomic_compare_exchange_weak_explicit(&p_rwlock->state, &state, state | _EVENT_RWLOCK_WRITERS_PARKED, memory_order_relaxed, memory_order_relaxed))
+            continue;
+
+        thrd_status = _event_park(_EVENT_RWLOCK_WRITERS_KEY(p_rwlock), _event_rwlock_writer_must_park, &p_rwlock->state, NULL);
+        if (thrd_status != thrd_success && thrd_status != thrd_busy)
+            return _thrd_status_to_errno(thrd_status);
+
+        parked = _EVENT_RWLOCK_WRITERS_PARKED;
+        state = atomic_load_explicit(&p_rwlock->state, memory_order_relaxed);
+    }
+}
+
+event_error_t event_rwlock_try_write_lock(event_rwlock_t* p_rwlock) {
+    if (!p_rwlock)
+        return EINVAL;
+
+    unsigned state = atomic_load_explicit(&p_rwlock->state, memory_order_relaxed);
+
+    while (!(state & _EVENT_RWLOCK_WRITER) && !_EVENT_RWLOCK_READERS(state)) {
+        if (atomic_compare_exchange_weak_explicit(&p_rwlock->state, &state, state | _EVENT_RWLOCK_WRITER, memory_order_acquire, memory_order_relaxed))
+            return 0;
+    }
+
+    return EBUSY;
+}
+
+event_error_t event_rwlock_write_unlock(event_rwlock_t* p_rwlock) {
+    if (!p_rwlock)
+        return EINVAL;
+
+    // Nobody else holds the lock, so clearing every bit is safe. Woken threads set the parked bits again if they have
+    // to park once more.
+    unsigned state = atomic_exchange_explicit(&p_rwlock->state, 0, memory_order_release);
+
+    if (state & _EVENT_RWLOCK_WRITERS_PARKED)
+        _event_unpark(_EVENT_RWLOCK_WRITERS_KEY(p_rwlock), 1);
+
+    if (state & _EVENT_RWLOCK_READERS_PARKED)
+        _event_unpark(_EVENT_RWLOCK_READERS_KEY(p_rwlock), SIZE_MAX);
+
+    return 0;
+}
+
+typedef struct _event_seq_wait_t {
+    atomic_uint_least64_t* p_seq;
+    uint_least64_t seq;
+} _event_seq_wait_t;
+
+static bool _event_seq_unchanged(void* ctx) {
+    _event_seq_wait_t* p_wait = ctx;
+    return atomic_load_explicit(p_wait->p_seq, memory_order_relaxed) == p_wait->seq;
+}
+
+// Park until '*p_seq' may differ from 'seq'. Registers in '*p_c_waiters' so that _event_seq_wake knows to wake.
+// Returns thrd_success, also if '*p_seq' already differed, or thrd_timedout.
+static int _event_seq_park(atomic_uint_least64_t* p_seq, uint_least64_t seq, atomic_uint* p_c_waiters, const struct timespec* p_time) {
+    _event_seq_wait_t wait = {p_seq, seq};
+
+    atomic_fetch_add_explicit(p_c_waiters, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int thrd_status = _event_park(p_seq, _event_seq_unchanged, &wait, p_time);
+    atomic_fetch_sub_explicit(p_c_waiters, 1, memory_order_relaxed);
+
+    return thrd_status == thrd_busy ? thrd_success : thrd_status;
+}
+
+// Wake all threads in _event_seq_park on 'p_seq' after it was advanced.
+static void _event_seq_wake(atomic_uint_least64_t* p_seq, atomic_uint* p_c_waiters) {
+    // Pairs with the fence in _event_seq_park: either the waiter sees the new sequence or this sees the waiter.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(p_c_waiters, memory_order_relaxed))
+        _event_unpark(p_seq, SIZE_MAX);
+}
+
+struct _event_watch_t {
+    // Serializes publishers. Readers never take it.
+    event_mutex_t writer_mtx;
+    // Threads parked on 'seq'. Publishers only go to the parking lot if there are any.
+    atomic_uint c_waiters;
+    // Odd while a publisher is copying the value in. The version is half of it.
+    atomic_uint_least64_t seq;
+    size_t size;
+    unsigned char value[];
+};
+
+// Largest value for which the size of event_watch_t does not overflow.
+#define _EVENT_WATCH_SIZE_MAX (SIZE_MAX - sizeof(event_watch_t))
+
+size_t event_watch_get_size(size_t size) {
+    return size > _EVENT_WATCH_SIZE_MAX ? 0 : sizeof(event_watch_t) + size;
+}
+
+event_error_t event_watch_init(event_watch_t* p_watch, const void* p_initial, size_t size) {
+    if (!p_watch || size > _EVENT_WATCH_SIZE_MAX)
+        return EINVAL;
+
+    event_mutex_init(&p_watch->writer_mtx);
+    atomic_init(&p_watch->c_waiters, 0);
+    atomic_init(&p_watch->seq, 0);
+    p_watch->size = size;
+
+    if (p_initial)
+        memcpy(p_watch->value, p_initial, size);
+    else
+        memset(p_watch->value, 0, size);
+
+    return 0;
+}
+
+void event_watch_destroy(event_watch_t* p_watch) {
+    (void)p_watch;
+}
+
+event_error_t event_watch_publish(event_watch_t* p_watch, const void* p_value) {
+    if (!p_watch || !p_value)
+        return EINVAL;
+
+    event_error_t err;
+
+    if ((err = event_mutex_lock(&p_watch->writer_mtx)))
+        return err;
+
+    uint_least64_t seq = atomic_load_explicit(&p_watch->seq, memory_order_relaxed);
+    atomic_store_explicit(&p_watch->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(p_watch->value, p_value, p_watch->size);
+    atomic_store_explicit(&p_watch->seq, seq + 2, memory_order_release);
+
+    err = event_mutex_unlock(&p_watch->writer_mtx);
+    _event_seq_wake(&p_watch->seq, &p_watch->c_waiters);
+
+    return err;
+}
+
+// Copy the value out, retrying while a publisher overwrites it. Returns the version copied.
+static uint_least64_t _event_watch_copy(event_watch_t* p_watch, void* p_value) {
+    uint_least64_t seq;
+
+    for (;;) {
+        if ((seq = atomic_load_explicit(&p_watch->seq, memory_order_acquire)) & 1) {
+            thrd_yield();
+            continue;
+        }
+
+        if (p_value)
+            memcpy(p_value, p_watch->value, p_watch->size);
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&p_watch->seq, memory_order_relaxed) == seq)
+            return seq / 2;
+    }
+}
+
+event_error_t event_watch_read(const event_watch_t* p_watch, void* p_value, uint_least64_t* p_version) {
+    if (!p_watch || !p_value)
+        return EINVAL;
+
+    uint_least64_t version = _event_watch_copy((event_watch_t*)p_watch, p_value);
+
+    if (p_version)
+        *p_version = version;
+
+    return 0;
+}
+
+event_error_t event_watch_wait(event_watch_t* p_watch, uint_least64_t* p_last_seen_version, void* p_value, const struct timespec* p_time) {
+    if (!p_watch || !p_last_seen_version)
+        return EINVAL;
+
+    uint_least64_t seq;
+    int thrd_status = thrd_success;
+
+    // A publish in progress still shows the old version, so keep waiting until it completes.
+    while ((seq = atomic_load_explicit(&p_watch->seq, memory_order_acquire)) / 2 == *p_last_seen_version) {
+        if (thrd_status != thrd_success)
+            return _thrd_status_to_errno(thrd_status);
+
+        thrd_status = _event_seq_park(&p_watch->seq, seq, &p_watch->c_waiters, p_time);
+    }
+
+    *p_last_seen_version = _event_watch_copy(p_watch, p_value);
+    return 0;
+}
+
+struct _event_snapshot_t {
+    // Held by the writer from event_snapshot_begin_write until it publishes or cancels.
+    event_mutex_t writer_mtx;
+    // Threads parked on 'flips'. The writer only goes to the parking lot on a flip if there are any.
+    atomic_uint c_waiters;
+    // Number of flips, which is the version. Readers copy buffer 'flips % 2'.
+    atomic_uint_least64_t flips;
+    size_t size;
+    // Distance between the buffers, 'size' rounded up so that both are aligned like max_align_t.
+    size_t stride;
+    max_align_t buffers[];
+};
+
+static inline size_t _event_snapshot_stride(size_t size) {
+    return (size + sizeof(max_align_t) - 1) / sizeof(max_align_t) * sizeof(max_align_t);
+}
+
+static inline unsigned char* _event_snapshot_buffer(event_snapshot_t* p_snapshot, uint_least64_t flips) {
+    return (unsigned char*)p_snapshot->buffers + (flips % 2) * p_snapshot->stride;
+}
+
+// Largest snapshot for which rounding up to the stride and the size of event_snapshot_t with both buffers do not
+// overflow.
+#define _EVENT_SNAPSHOT_SIZE_MAX ((SIZE_MAX - sizeof(event_snapshot_t)) / 2 - sizeof(max_align_t))
+
+size_t event_snapshot_get_size(size_t size) {
+    return size > _EVENT_SNAPSHOT_SIZE_MAX ? 0 : sizeof(event_snapshot_t) + 2 * _event_snapshot_stride(size);
+}
+
+event_error_t event_snapshot_init(event_snapshot_t* p_snapshot, const void* p_initial, size_t size) {
+    if (!p_snapshot || size > _EVENT_SNAPSHOT_SIZE_MAX)
+        return EINVAL;
+
+    event_mutex_init(&p_snapshot->writer_mtx);
+    atomic_init(&p_snapshot->c_waiters, 0);
+    atomic_init(&p_snapshot->flips, 0);
+    p_snapshot->size = size;
+    p_snapshot->stride = _event_snapshot_stride(size);
+
+    for (uint_least64_t flips = 0; flips < 2; ++flips) {
+        if (p_initial)
+            memcpy(_event_snapshot_buffer(p_snapshot, flips), p_initial, size);
+        else
+            memset(_event_snapshot_buffer(p_snapshot, flips), 0, size);
+    }
+
+    return 0;
+}
+
+void event_snapshot_destroy(event_snapshot_t* p_snapshot) {
+    (void)p_snapshot;
+}
+
+event_error_t event_snapshot_begin_write(event_snapshot_t* p_snapshot, bool copy_front, void** pp_back) {
+    if (!p_snapshot || !pp_back)
+        return EINVAL;
+
+    event_error_t err;
+
+    if ((err = event_mutex_lock(&p_snapshot->writer_mtx)))
+        return err;
+
+    uint_least64_t flips = atomic_load_explicit(&p_snapshot->flips, memory_order_relaxed);
+    unsigned char* p_back = _event_snapshot_buffer(p_snapshot, flips + 1);
+
+    // Readers that still copy the back buffer started before the last flip and retry once they see it. Order the
+    // writes to the back buffer after that flip.
+    atomic_thread_fence(memory_order_release);
+
+    if (copy_front)
+        memcpy(p_back, _event_snapshot_buffer(p_snapshot, flips), p_snapshot->size);
+
+    *pp_back = p_back;
+    return 0;
+}
+
+event_error_t event_snapshot_publish(event_snapshot_t* p_snapshot) {
+    if (!p_snapshot)
+        return EINVAL;
+
+    atomic_store_explicit(&p_snapshot->flips, atomic_load_explicit(&p_snapshot->flips, memory_order_relaxed) + 1, memory_order_release);
+
+    event_error_t err = event_mutex_unlock(&p_snapshot->writer_mtx);
+    _event_seq_wake(&p_snapshot->flips, &p_snapshot->c_waiters);
+
+    return err;
+}
+
+event_error_t event_snapshot_cancel_write(event_snapshot_t* p_snapshot) {
+    if (!p_snapshot)
+        return EINVAL;
+
+    return event_mutex_unlock(&p_snapshot->writer_mtx);
+}
+
+// Copy the front buffer out, retrying if the writer flipped meanwhile. Returns the version copied.
+static uint_least64_t _event_snapshot_copy(event_snapshot_t* p_snapshot, void* p_value) {
+    uint_least64_t flips;
+
+    do {
+        flips = atomic_load_explicit(&p_snapshot->flips, memory_order_acquire);
+        if (p_value)
+            memcpy(p_value, _event_snapshot_buffer(p_snapshot, flips), p_snapshot->size);
+        atomic_thread_fence(memory_order_acquire);
+    } while (atomic_load_explicit(&p_snapshot->flips, memory_order_relaxed) != flips);
+
+    return flips;
+}
+
+event_error_t event_snapshot_read(const event_snapshot_t* p_snapshot, void* p_value, uint_least64_t* p_version) {
+    if (!p_snapshot || !p_value)
+        return EINVAL;
+
+    uint_least64_t version = _event_snapshot_copy((event_snapshot_t*)p_snapshot, p_value);
+
+    if (p_version)
+        *p_version = version;
+
+    return 0;
+}
+
+event_error_t event_snapshot_wait(event_snapshot_t* p_snapshot, uint_least64_t* p_last_seen_version, void* p_value, const struct timespec* p_time) {
+    if (!p_snapshot || !p_last_seen_version)
+        return EINVAL;
+
+    uint_least64_t flips;
+    int thrd_status = thrd_success;
+
+    while ((flips = atomic_load_explicit(&p_snapshot->flips, memory_order_acquire)) == *p_last_seen_version) {
+        if (thrd_status != thrd_success)
+            return _thrd_status_to_errno(thrd_status);
+
+        thrd_status = _event_seq_park(&p_snapshot->flips, flips, &p_snapshot->c_waiters, p_time);
+    }
+
+    *p_last_seen_version = _event_snapshot_copy(p_snapshot, p_value);
+    return 0;
+}
+
+// Initial capacity for the items of a group commit batch.
+#define EVENT_GROUP_COMMIT_ITEMS 16
+
+typedef struct _event_group_batch_t {
+    // Signaled by the leader once 'result' is set.
+    struct _event_t done;
+    // Callers that still need the batch. The last one releases it.
+    atomic_uint c_refs;
+    int result;
+    size_t c_items;
+    size_t c_items_max;
+    void** p_items;
+} _event_group_batch_t;
+
+struct _event_group_commit_t {
+    event_mutex_t mtx;
+    // Signaled when a commit finishes while the next batch waits for its leader.
+    struct _event_t idle;
+    event_group_commit_fn_t fn;
+    void* ctx;
+    // The batch new callers join, or null. Its first caller leads it.
+    _event_group_batch_t* p_open;
+    // A leader is running 'fn'.
+    bool committing;
+    // A released batch kept for reuse, or null.
+    _event_group_batch_t* p_spare;
+};
+
+static void _event_group_batch_free(_event_group_batch_t* p_batch) {
+    event_destroy(&p_batch->done);
+    free(p_batch->p_items);
+    free(p_batch);
+}
+
+// Take the spare batch or allocate one. Called with the group locked.
+static _event_group_batch_t* _event_group_batch_new(event_group_commit_t* p_group) {
+    _event_group_batch_t* p_batch = p_group->p_spare;
+
+    if (p_batch) {
+        p_group->p_spare = NULL;
+    } else {
+        if (!(p_batch = malloc(sizeof(*p_batch))))
+            return NULL;
+
+        if (!(p_batch->p_items = malloc(EVENT_GROUP_COMMIT_ITEMS * sizeof(*p_batch->p_items)))) {
+            free(p_batch);
+            return NULL;
+        }
+
+        if (event_init(&p_batch->done, true, false)) {
+            free(p_batch->p_items);
+            free(p_batch);
+            return NULL;
+        }
+
+        p_batch->c_items_max = EVENT_GROUP_COMMIT_ITEMS;
+    }
+
+    atomic_init(&p_batch->c_refs, 0);
+    p_batch->result = 0;
+    p_batch->c_items = 0;
+    return p_batch;
+}
+
+static void _event_group_batch_release(event_group_commit_t* p_group, _event_group_batch_t* p_batch) {
+    if (atomic_fetch_sub_explicit(&p_batch->c_refs, 1, memory_order_acq_rel) != 1)
+        return;
+
+    event_reset(&p_batch->done);
+
+    if (!event_mutex_lock(&p_group->mtx)) {
+        if (!p_group->p_spare) {
+            p_group->p_spare = p_batch;
+            p_batch = NULL;
+        }
+        event_mutex_unlock(&p_group->mtx);
+    }
+
+    if (p_batch)
+        _event_group_batch_free(p_batch);
+}
+
+size_t event_group_commit_get_size(void) {
+    return sizeof(event_group_commit_t);
+}
+
+event_error_t event_group_commit_init(event_group_commit_t* p_group, event_group_commit_fn_t fn, void* ctx) {
+    if (!p_group || !fn)
+        return EINVAL;
+
+    event_error_t err;
+
+    if ((err = event_init(&p_group->idle, false, false)))
+        return err;
+
+    event_mutex_init(&p_group->mtx);
+    p_group->fn = fn;
+    p_group->ctx = ctx;
+    p_group->p_open = NULL;
+    p_group->committing = false;
+    p_group->p_spare = NULL;
+    return 0;
+}
+
+void event_group_commit_destroy(event_group_commit_t* p_group) {
+    if (p_group) {
+        if (p_group->p_spare)
+            _event_group_batch_free(p_group->p_spare);
+        event_destroy(&p_group->idle);
+    }
+}
+
+event_error_t event_group_commit_submit(event_group_commit_t* p_group, void* item, int* p_result) {
+    if (!p_group || !p_result)
+        return EINVAL;
+
+    event_error_t err;
+    _event_group_batch_t* p_batch;
+    bool is_leader = false;
+
+    if ((err = event_mutex_lock(&p_group->mtx)))
+        return err;
+
+    if (!(p_batch = p_group->p_open)) {
+        if (!(p_batch = _event_group_batch_new(p_group))) {
+            err = ENOMEM;
+            goto unlock;
+        }
+        p_group->p_open = p_batch;
+        is_leader = true;
+    }
+
+    if (p_batch->c_items == p_batch->c_items_max) {
+        void** p_items = realloc(p_batch->p_items, 2 * p_batch->c_items_max * sizeof(*p_items));
+        // Only followers get here, so the batch keeps its leader.
+        if (!p_items) {
+            err = ENOMEM;
+            goto unlock;
+        }
+        p_batch->p_items = p_items;
+        p_batch->c_items_max *= 2;
+    }
+
+    p_batch->p_items[p_batch->c_items++] = item;
+    atomic_fetch_add_explicit(&p_batch->c_refs, 1, memory_order_relaxed);
+
+    if (!is_leader) {
+        event_mutex_unlock(&p_group->mtx);
+
+        // Followers only wake once, when their result is ready.
+        if (!(err = event_wait(&p_batch->done, NULL)))
+            *p_result = p_batch->result;
+
+        _event_group_batch_release(p_group, p_batch);
+        return err;
+    }
+
+    // Keep collecting followers while the previous batch commits.
+    while (p_group->committing) {
+        event_mutex_unlock(&p_group->mtx);
+        err = event_wait(&p_group->idle, NULL);
+        _event_mutex_lock_always(&p_group->mtx);
+
+        // Fail the batch instead of stranding it: its followers and anyone still joining would wait for it forever.
+        if (err) {
+            p_group->p_open = NULL;
+            event_mutex_unlock(&p_group->mtx);
+            p_batch->result = err;
+            event_signal(&p_batch->done);
+            _event_group_batch_release(p_group, p_batch);
+            return err;
+        }
+    }
+
+    p_group->committing = true;
+    p_group->p_open = NULL;
+    event_mutex_unlock(&p_group->mtx);
+
+    p_batch->result = p_group->fn(p_group->ctx, p_batch->p_items, p_batch->c_items);
+
+    // Leaving 'committing' set would block every later leader, so this lock cannot fail.
+    _event_mutex_lock_always(&p_group->mtx);
+    p_group->committing = false;
+    _event_group_batch_t* p_next = p_group->p_open;
+    event_mutex_unlock(&p_group->mtx);
+
+    // Release the followers first, then hand over to the leader of the next batch.
+    event_signal(&p_batch->done);
+    if (p_next)
+        event_signal(&p_group->idle);
+
+    *p_result = p_batch->result;
+    _event_group_batch_release(p_group, p_batch);
+    return 0;
+
+unlock:
+    event_mutex_unlock(&p_group->mtx);
+    return err;
+}
+
+// Buckets of an event_single_flight_t, each with its own lock. Power of 2.
+#define EVENT_SINGLE_FLIGHT_BUCKETS 64
+
+typedef struct _event_flight_t {
+    struct _event_flight_t* p_next;
+    // Signaled by the computing caller once 'value' is set. Manual-reset, so one signal releases all waiters.
+    struct _event_t done;
+    // Callers that still need the flight. The last one frees it.
+    atomic_uint c_refs;
+    void* value;
+    uint_least64_t hash;
+    size_t key_size;
+    unsigned char key[];
+} _event_flight_t;
+
+typedef struct _event_flight_bucket_t {
+    event_mutex_t mtx;
+    // Flights in progress. Finished flights are unlinked before they are signaled.
+    _event_flight_t* p_flights;
+} _event_flight_bucket_t;
+
+struct _event_single_flight_t {
+    _event_flight_bucket_t buckets[EVENT_SINGLE_FLIGHT_BUCKETS];
+};
+
+// FNV-1a.
+static uint_least64_t _event_flight_hash(const void* key, size_t key_size) {
+    const unsigned char* p = key;
+    uint_least64_t hash = 14695981039346656037u;
+
+    for (size_t i = 0; i < key_size; ++i)
+        hash = (hash ^ p[i]) * 1099511628211u;
+
+    return hash;
+}
+
+static void _event_flight_release(_event_flight_t* p_flight) {
+    if (atomic_fetch_sub_explicit(&p_flight->c_refs, 1, memory_order_acq_rel) == 1) {
+        event_destroy(&p_flight->done);
+        free(p_flight);
+    }
+}
+
+size_t event_single_flight_get_size(void) {
+    return sizeof(event_single_flight_t);
+}
+
+event_error_t event_single_flight_init(event_single_flight_t* p_flights) {
+    if (!p_flights)
+        return EINVAL;
+
+    for (size_t i = 0; i < EVENT_SINGLE_FLIGHT_BUCKETS; ++i) {
+        event_mutex_init(&p_flights->buckets[i].mtx);
+        p_flights->buckets[i].p_flights = NULL;
+    }
+
+    return 0;
+}
+
+void event_single_flight_destroy(event_single_flight_t* p_flights) {
+    (void)p_flights;
+}
+
+event_error_t event_single_flight_do(event_single_flight_t* p_flights, const void* key, size_t key_size, event_single_flight_fn_t fn, void* ctx, void** p_value, bool* p_shared) {
+    if (!p_flights || (!key && key_size) || !fn || !p_value)
+        return EINVAL;
+
+    uint_least64_t hash = _event_flight_hash(key, key_size);
+    _event_flight_bucket_t* p_bucket = &p_flights->buckets[hash & (EVENT_SINGLE_FLIGHT_BUCKETS - 1)];
+    _event_flight_t* p_flight;
+    event_error_t err;
+
+    if ((err = event_mutex_lock(&p_bucket->mtx)))
+        return err;
+
+    for (p_flight = p_bucket->p_flights; p_flight; p_flight = p_flight->p_next) {
+        if (p_flight->hash == hash && p_flight->key_size == key_size && !memcmp(p_flight->key, key, key_size))
+            break;
+    }
+
+    if (p_flight) {
+        atomic_fetch_add_explicit(&p_flight->c_refs, 1, memory_order_relaxed);
+        event_mutex_unlock(&p_bucket->mtx);
+
+        if (!(err = event_wait(&p_flight->done, NULL))) {
+            *p_value = p_flight->value;
+            if (p_shared)
+                *p_shared = true;
+        }
+
+        _event_flight_release(p_flight);
+        return err;
+    }
+
+    if (!(p_flight = malloc(sizeof(*p_flight) + key_size))) {
+        event_mutex_unlock(&p_bucket->mtx);
+        return ENOMEM;
+    }
+
+    if ((err = event_init(&p_flight->done, true, false))) {
+        event_mutex_unlock(&p_bucket->mtx);
+        free(p_flight);
+        return err;
+    }
+
+    atomic_init(&p_flight->c_refs, 1);
+    p_flight->hash = hash;
+    p_flight->key_size = key_size;
+    if (key_size)
+        memcpy(p_flight->key, key, key_size);
+    p_flight->p_next = p_bucket->p_flights;
+    p_bucket->p_flights = p_flight;
+    event_mutex_unlock(&p_bucket->mtx);
+
+    p_flight->value = fn(ctx);
+
+    // Unlink before signaling, so that callers arriving from now on start a new flight instead of joining this one.
+    // Nobody can join after that, so the reference count tells whether the value was shared. A flight left linked would
+    // be joined after it is freed, so this lock cannot fail.
+    _event_mutex_lock_always(&p_bucket->mtx);
+    _event_flight_t** pp_flight = &p_bucket->p_flights;
+    while (*pp_flight != p_flight)
+        pp_flight = &(*pp_flight)->p_next;
+    *pp_flight = p_flight->p_next;
+    event_mutex_unlock(&p_bucket->mtx);
+
+    *p_value = p_flight->value;
+    if (p_shared)
+        *p_shared = atomic_load_explicit(&p_flight->c_refs, memory_order_relaxed) > 1;
+
+    event_signal(&p_flight->done);
+    _event_flight_release(p_flight);
+    return 0;
+}
+
+struct _event_batch_t {
+    // Items added since the consumer last took them.
+    atomic_size_t c_pending;
+    // When the first of the pending items was added, on _event_monotonic_ns, or 0 until its producer stored it.
+    atomic_uint_least64_t first_ns;
+    // Advanced by producers to wake the consumer, on the first item and on reaching the size.
+    atomic_uint_least64_t seq;
+    // Consumers parked on 'seq'. Producers only go to the parking lot if there are any.
+    atomic_uint c_waiters;
+    size_t c_max;
+    uint_least64_t max_delay_ns;
+};
+
+size_t event_batch_get_size(void) {
+    return sizeof(event_batch_t);
+}
+
+event_error_t event_batch_init(event_batch_t* p_batch, size_t c_max, const struct timespec* p_max_delay) {
+    if (!p_batch || !c_max || !p_max_delay || p_max_delay->tv_sec < 0 || p_max_delay->tv_nsec < 0 || p_max_delay->tv_nsec >= 1000000000)
+        return EINVAL;
+
+    atomic_init(&p_batch->c_pending, 0);
+    atomic_init(&p_batch->first_ns, 0);
+    atomic_init(&p_batch->seq, 0);
+    atomic_init(&p_batch->c_waiters, 0);
+    p_batch->c_max = c_max;
+    p_batch->max_delay_ns = (uint_least64_t)p_max_delay->tv_sec * 1000000000u + (uint_least64_t)p_max_delay->tv_nsec;
+    return 0;
+}
+
+void event_batch_destroy(event_batch_t* p_batch) {
+    (void)p_batch;
+}
+
+static void _event_batch_wake(event_batch_t* p_batch) {
+    atomic_fetch_add_explicit(&p_batch->seq, 1, memory_order_release);
+    _event_seq_wake(&p_batch->seq, &p_batch->c_waiters);
+}
+
+event_error_t event_batch_add(event_batch_t* p_batch, size_t c_items) {
+    if (!p_batch)
+        return EINVAL;
+
+    if (!c_items)
+        return 0;
+
+    // Acquire pairs with the release of event_batch_take's exchange, so that a producer finding the batch empty stores
+    // its timestamp after the consumer cleared the old one.
+    size_t c_pending = atomic_fetch_add_explicit(&p_batch->c_pending, c_items, memory_order_acq_rel);
+
+    // Only the first item starts the consumer's timer and only the item reaching the size ends it early; all others
+    // are a single atomic add.
+    if (!c_pending) {
+        atomic_store_explicit(&p_batch->first_ns, _event_monotonic_ns(), memory_order_release);
+        _event_batch_wake(p_batch);
+    } else if (c_pending < p_batch->c_max && c_pending + c_items >= p_batch->c_max) {
+        _event_batch_wake(p_batch);
+    }
+
+    return 0;
+}
+
+event_error_t event_batch_take(event_batch_t* p_batch, size_t* p_c_items) {
+    if (!p_batch || !p_c_items)
+        return EINVAL;
+
+    // Clear the timestamp first: a producer finding the batch empty after the exchange stores a new one after this. The
+    // exchange releases the clear to that producer, so the clear cannot land on top of the new timestamp.
+    atomic_store_explicit(&p_batch->first_ns, 0, memory_order_relaxed);
+    *p_c_items = atomic_exchange_explicit(&p_batch->c_pending, 0, memory_order_acq_rel);
+    return 0;
+}
+
+event_error_t event_batch_wait(event_batch_t* p_batch, size_t* p_c_items, const struct timespec* p_time) {
+    if (!p_batch || !p_c_items)
+        return EINVAL;
+
+    uint_least64_t time_ns = p_time ? (uint_least64_t)p_time->tv_sec * 1000000000u + (uint_least64_t)p_time->tv_nsec : UINT_LEAST64_MAX;
+
+    for (;;) {
+        // Read the sequence before the state, so that a wake after the check makes the park return at once.
+        uint_least64_t seq = atomic_load_explicit(&p_batch->seq, memory_order_acquire);
+        size_t c_pending = atomic_load_explicit(&p_batch->c_pending, memory_order_acquire);
+        uint_least64_t first_ns = atomic_load_explicit(&p_batch->first_ns, memory_order_acquire);
+        uint_least64_t now_ns = _event_now_ns();
+        uint_least64_t monotonic_ns = _event_monotonic_ns();
+        uint_least64_t deadline_ns = time_ns;
+
+        if (c_pending && (c_pending >= p_batch->c_max || (first_ns && monotonic_ns - first_ns >= p_batch->max_delay_ns))) {
+            event_batch_take(p_batch, p_c_items);
+            // Another consumer may have taken them first.
+            if (*p_c_items)
+                return 0;
+            continue;
+        }
+
+        // Until the first producer stored its timestamp, wait for its wake. The delay is measured on the monotonic clock
+        // and only turned into a TIME_UTC deadline for this one park, after which it is checked again.
+        if (c_pending && first_ns && now_ns + (first_ns + p_batch->max_delay_ns - monotonic_ns) < deadline_ns)
+            deadline_ns = now_ns + (first_ns + p_batch->max_delay_ns - monotonic_ns);
+        else if (now_ns >= time_ns)
+            return ETIMEDOUT;
+
+        struct timespec deadline = {.tv_sec = (time_t)(deadline_ns / 1000000000u), .tv_nsec = (long)(deadline_ns % 1000000000u)};
+        int thrd_status = _event_seq_park(&p_batch->seq, seq, &p_batch->c_waiters, deadline_ns == UINT_LEAST64_MAX ? NULL : &deadline);
+
+        if (thrd_status != thrd_success && thrd_status != thrd_timedout)
+            return _thrd_status_to_errno(thrd_status);
+    }
+}
+
+#ifdef EVENTS_PROFILE
+event_error_t event_profile_dump(FILE* p_file) {
+    if (!p_file)
+        return EINVAL;
+
+    _event_profile_entry_t* p_entries = calloc(EVENT_PROFILE_SITES, sizeof(_event_profile_entry_t));
+    if (!p_entries)
+        return errno;
+
+    size_t c_entries = 0;
+    for (size_t i = 0; i < EVENT_PROFILE_SITES; ++i) {
+        _event_profile_site_t* p_site = &_event_profile_sites[i];
+        _event_profile_entry_t* p_entry = &p_entries[c_entries];
+
+        if (!(p_entry->caller = atomic_load_explicit(&p_site->caller, memory_order_acquire)))
+            continue;
+
+        p_entry->count = atomic_load_explicit(&p_site->count, memory_order_relaxed);
+        p_entry->total_ns = atomic_load_explicit(&p_site->total_ns, memory_order_relaxed);
+        p_entry->max_ns = atomic_load_explicit(&p_site->max_ns, memory_order_relaxed);
+        p_entry->event_name = atomic_load_explicit(&p_site->event_name, memory_order_relaxed);
+        if (p_entry->count)
+            ++c_entries;
+    }
+
+    qsort(p_entries, c_entries, sizeof(_event_profile_entry_t), _event_profile_entry_cmp);
+
+    int err = 0;
+    if (fprintf(p_file, "%-18s %12s %16s %14s %14s  %s\n", "caller", "count", "total_ns", "avg_ns", "max_ns", "event") < 0)
+        err = EIO;
+
+    for (size_t i = 0; i < c_entries && !err; ++i) {
+        _event_profile_entry_t* p_entry = &p_entries[i];
+        if (fprintf(p_file, "%#-18jx %12ju %16ju %14ju %14ju  %s\n", (uintmax_t)p_entry->caller, (uintmax_t)p_entry->count,
+                    (uintmax_t)p_entry->total_ns, (uintmax_t)(p_entry->total_ns / p_entry->count), (uintmax_t)p_entry->max_ns,
+                    p_entry->event_name ? p_entry->event_name : "-") < 0)
+            err = EIO;
+    }
+
+    uint_least64_t dropped = atomic_load_explicit(&_event_profile_dropped, memory_order_relaxed);
+    if (!err && dropped && fprintf(p_file, "dropped %ju waits: call site table full\n", (uintmax_t)dropped) < 0)
+        err = EIO;
+
+    event_phase_stats_t phases[EVENT_PHASE_COUNT];
+    event_profile_get_phases(phases);
+
+    if (!err && phases[EVENT_PHASE_ALLOC].count &&
+        fprintf(p_file, "\n%-18s %12s %16s %14s %14s\n", "wait_multiple", "count", "total_ns", "avg_ns", "max_ns") < 0)
+        err = EIO;
+
+    for (int i = 0; i < EVENT_PHASE_COUNT && !err && phases[EVENT_PHASE_ALLOC].count; ++i) {
+        if (fprintf(p_file, "%-18s %12ju %16ju %14ju %14ju\n", event_phase_get_name((event_phase_t)i), (uintmax_t)phases[i].count,
+                    (uintmax_t)phases[i].total_ns, (uintmax_t)(phases[i].count ? phases[i].total_ns / phases[i].count : 0),
+                    (uintmax_t)phases[i].max_ns) < 0)
+            err = EIO;
+    }
+
+    free(p_entries);
+    return err;
+}
+
+event_error_t event_profile_get_phases(event_phase_stats_t* p_stats) {
+    if (!p_stats)
+        return EINVAL;
+
+    for (int i = 0; i < EVENT_PHASE_COUNT; ++i) {
+        p_stats[i].count = atomic_load_explicit(&_event_profile_phases[i].count, memory_order_relaxed);
+        p_stats[i].total_ns = atomic_load_explicit(&_event_profile_phases[i].total_ns, memory_order_relaxed);
+        p_stats[i].max_ns = atomic_load_explicit(&_event_profile_phases[i].max_ns, memory_order_relaxed);
+    }
+
+    return 0;
+}
+
+void event_profile_reset(void) {
+    for (size_t i = 0; i < EVENT_PROFILE_SITES; ++i) {
+        _event_profile_site_t* p_site = &_event_profile_sites[i];
+        atomic_store_explicit(&p_site->count, 0, memory_order_relaxed);
+        atomic_store_explicit(&p_site->total_ns, 0, memory_order_relaxed);
+        atomic_store_explicit(&p_site->max_ns, 0, memory_order_relaxed);
+    }
+
+    for (int i = 0; i < EVENT_PHASE_COUNT; ++i) {
+        atomic_store_explicit(&_event_profile_phases[i].count, 0, memory_order_relaxed);
+        atomic_store_explicit(&_event_profile_phases[i].total_ns, 0, memory_order_relaxed);
+        atomic_store_explicit(&_event_profile_phases[i].max_ns, 0, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&_event_profile_dropped, 0, memory_order_relaxed);
+}
+#else
+event_error_t event_profile_dump(FILE* p_file) {
+    (void)p_file;
+    return ENOTSUP;
+}
+
+void event_profile_reset(void) {
+}
+
+event_error_t event_profile_get_phases(event_phase_stats_t* p_stats) {
+    (void)p_stats;
+    return ENOTSUP;
+}
+#endif
+
+const char* event_phase_get_name(event_phase_t phase) {
+    static const char* const names[EVENT_PHASE_COUNT] = {"alloc", "init", "spawn", "rendezvous", "cancel", "join", "teardown"};
+    return (unsigned)phase < EVENT_PHASE_COUNT ? names[phase] : NULL;
+}
+
+#ifdef EVENTS_TRACE
+static const char* const _event_trace_names[] = {
+    [_EVENT_TRACE_SIGNAL] = "signal",
+    [_EVENT_TRACE_RESET] = "reset",
+    [_EVENT_TRACE_WAIT_BEGIN] = "wait",
+    [_EVENT_TRACE_WAIT_END] = "wait",
+    [_EVENT_TRACE_TIMEOUT] = "timeout",
+    [_EVENT_TRACE_WAIT_MULTIPLE_BEGIN] = "wait_multiple",
+    [_EVENT_TRACE_WAIT_MULTIPLE_END] = "wait_multiple",
+};
+
+static int _event_write_json_string(FILE* p_file, const char* str) {
+    if (fputc('"', p_file) == EOF)
+        return EIO;
+
+    for (; *str; ++str) {
+        unsigned char c = (unsigned char)*str;
+        int result;
+
+        if (c == '"' || c == '\\')
+            result = fprintf(p_file, "\\%c", c);
+        else if (c < 0x20)
+            result = fprintf(p_file, "\\u%04x", c);
+        else
+            result = fputc(c, p_file);
+
+        if (result < 0)
+            return EIO;
+    }
+
+    if (fputc('"', p_file) == EOF)
+        return EIO;
+
+    return 0;
+}
+
+static int _event_trace_write_record(FILE* p_file, bool* p_first, unsigned long thread_id, int kind, uint_least64_t ts_ns, const event_t* p_event, const char* event_name, uint_least64_t flow_id) {
+    const char* phase;
+
+    switch (kind) {
+        case _EVENT_TRACE_WAIT_BEGIN:
+        case _EVENT_TRACE_WAIT_MULTIPLE_BEGIN:
+            phase = "B";
+            break;
+        case _EVENT_TRACE_WAIT_END:
+        case _EVENT_TRACE_WAIT_MULTIPLE_END:
+            phase = "E";
+            break;
+        default:
+            phase = "i";
+            break;
+    }
+
+    const char* sep = *p_first ? "\n" : ",\n";
+    *p_first = false;
+
+    if (fprintf(p_file, "%s{\"name\":\"%s\",\"cat\":\"event\",\"ph\":\"%s\",\"s\":\"t\",\"ts\":%ju.%03u,\"pid\":1,\"tid\":%lu,\"args\":{\"event\":\"%p\"",
+                sep, _event_trace_names[kind], phase, (uintmax_t)(ts_ns / 1000), (unsigned)(ts_ns % 1000), thread_id, (const void*)p_event) < 0)
+        return EIO;
+
+    if (event_name && (fputs(",\"label\":", p_file) == EOF || _event_write_json_string(p_file, event_name)))
+        return EIO;
+
+    if (fputs("}}", p_file) == EOF)
+        return EIO;
+
+    // Flow arrows connect a signal to the wait it completed.
+    if (flow_id && (kind == _EVENT_TRACE_SIGNAL || kind == _EVENT_TRACE_WAIT_END)) {
+        if (fprintf(p_file, ",\n{\"name\":\"wake\",\"cat\":\"event\",\"ph\":\"%s\",\"bp\":\"e\",\"id\":%ju,\"ts\":%ju.%03u,\"pid\":1,\"tid\":%lu}",
+                    kind == _EVENT_TRACE_SIGNAL ? "s" : "f", (uintmax_t)flow_id, (uintmax_t)(ts_ns / 1000), (unsigned)(ts_ns % 1000), thread_id) < 0)
+            return EIO;
+    }
+
+    return 0;
+}
+
+event_error_t event_trace_write(FILE* p_file) {
+    if (!p_file)
+        return EINVAL;
+
+    bool first = true;
+
+    if (fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", p_file) == EOF)
+        return EIO;
+
+    for (_event_trace_ring_t* p_ring = atomic_load_explicit(&_event_trace_rings, memory_order_acquire); p_ring; p_ring = p_ring->p_next) {
+        size_t head = atomic_load_explicit(&p_ring->head, memory_order_acquire);
+        size_t begin = head > EVENT_TRACE_RING_SIZE ? head - EVENT_TRACE_RING_SIZE : 0;
+
+        for (size_t i = begin; i < head; ++i) {
+            _event_trace_record_t* p_record = &p_ring->records[i & (EVENT_TRACE_RING_SIZE - 1)];
+            uint_least64_t ts_ns = atomic_load_explicit(&p_record->ts_ns, memory_order_relaxed);
+            uint_least64_t flow_id = atomic_load_explicit(&p_record->flow_id, memory_order_relaxed);
+            const event_t* p_event = atomic_load_explicit(&p_record->p_event, memory_order_relaxed);
+            const char* event_name = atomic_load_explicit(&p_record->event_name, memory_order_relaxed);
+            int kind = atomic_load_explicit(&p_record->kind, memory_order_relaxed);
+
+            // Drop the record if the owner may have wrapped around and overwritten it while it was read.
+            atomic_thread_fence(memory_order_acquire);
+            if (i + EVENT_TRACE_RING_SIZE <= atomic_load_explicit(&p_ring->head, memory_order_relaxed))
+                continue;
+
+            int err = _event_trace_write_record(p_file, &first, p_ring->thread_id, kind, ts_ns, p_event, event_name, flow_id);
+            if (err)
+                return err;
+        }
+    }
+
+    if (fputs("\n]}\n", p_file) == EOF)
+        return EIO;
+
+    return 0;
+}
+#else
+event_error_t event_trace_write(FILE* p_file) {
+    (void)p_file;
+    return ENOTSUP;
+}
+#endif
+
+#ifdef EVENTS_METRICS
+typedef struct _event_metrics_buf_t {
+    char* p_buf;
+    size_t c_buf;
+    size_t len;
+} _event_metrics_buf_t;
+
+static void _event_metrics_printf(_event_metrics_buf_t* p_out, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+
+    int len = vsnprintf(p_out->len < p_out->c_buf ? p_out->p_buf + p_out->len : NULL, p_out->len < p_out->c_buf ? p_out->c_buf - p_out->len : 0, format, args);
+    if (len > 0)
+        p_out->len += (size_t)len;
+
+    va_end(args);
+}
+
+// Print 'name="value"' with OpenMetrics escaping.
+static void _event_metrics_label(_event_metrics_buf_t* p_out, const char* name, const char* value) {
+    _event_metrics_printf(p_out, "%s=\"", name);
+
+    for (; *value; ++value) {
+        if (*value == '"' || *value == '\\')
+            _event_metrics_printf(p_out, "\\%c", *value);
+        else if (*value == '\n')
+            _event_metrics_printf(p_out, "\\n");
+        else
+            _event_metrics_printf(p_out, "%c", *value);
+    }
+
+    _event_metrics_printf(p_out, "\"");
+}
+
+static void _event_metrics_sample(_event_metrics_buf_t* p_out, const char* metric, const char* event_name, uint_least64_t value) {
+    _event_metrics_printf(p_out, "%s", metric);
+    if (event_name) {
+        _event_metrics_printf(p_out, "{");
+        _event_metrics_label(p_out, "event", event_name);
+        _event_metrics_printf(p_out, "}");
+    }
+    _event_metrics_printf(p_out, " %ju\n", (uintmax_t)value);
+}
+
+static void _event_metrics_histogram(_event_metrics_buf_t* p_out, const char* family, const char* event_name, const uint_least64_t* p_buckets, uint_least64_t wait_ns) {
+    static const char* const bounds[EVENT_METRICS_BUCKETS] = {"1e-06", "1e-05", "0.0001", "0.001", "0.01", "0.1", "1.0", "10.0", "+Inf"};
+    uint_least64_t cumulative = 0;
+
+    for (size_t i = 0; i < EVENT_METRICS_BUCKETS; ++i) {
+        cumulative += p_buckets[i];
+        _event_metrics_printf(p_out, "%s_bucket{", family);
+        if (event_name) {
+            _event_metrics_label(p_out, "event", event_name);
+            _event_metrics_printf(p_out, ",");
+        }
+        _event_metrics_printf(p_out, "le=\"%s\"} %ju\n", bounds[i], (uintmax_t)cumulative);
+    }
+
+    _event_metrics_printf(p_out, "%s_count", family);
+    if (event_name) {
+        _event_metrics_printf(p_out, "{");
+        _event_metrics_label(p_out, "event", event_name);
+        _event_metrics_printf(p_out, "}");
+    }
+    _event_metrics_printf(p_out, " %ju\n", (uintmax_t)cumulative);
+
+    _event_metrics_printf(p_out, "%s_sum", family);
+    if (event_name) {
+        _event_metrics_printf(p_out, "{");
+        _event_metrics_label(p_out, "event", event_name);
+        _event_metrics_printf(p_out, "}");
+    }
+    _event_metrics_printf(p_out, " %ju.%09u\n", (uintmax_t)(wait_ns / 1000000000u), (unsigned)(wait_ns % 1000000000u));
+}
+
+// Plain copy of _event_counters_t, summed over all events sharing a name.
+typedef struct _event_metrics_totals_t {
+    const char* name;
+    uint_least64_t signals;
+    uint_least64_t waits;
+    uint_least64_t timeouts;
+    uint_least64_t contended;
+    uint_least64_t wait_ns;
+    uint_least64_t wait_buckets[EVENT_METRICS_BUCKETS];
+} _event_metrics_totals_t;
+
+static void _event_metrics_add(_event_metrics_totals_t* p_totals, _event_counters_t* p_counters) {
+    p_totals->signals += atomic_load_explicit(&p_counters->signals, memory_order_relaxed);
+    p_totals->waits += atomic_load_explicit(&p_counters->waits, memory_order_relaxed);
+    p_totals->timeouts += atomic_load_explicit(&p_counters->timeouts, memory_order_relaxed);
+    p_totals->contended += atomic_load_explicit(&p_counters->contended, memory_order_relaxed);
+    p_totals->wait_ns += atomic_load_explicit(&p_counters->wait_ns, memory_order_relaxed);
+    for (size_t i = 0; i < EVENT_METRICS_BUCKETS; ++i)
+        p_totals->wait_buckets[i] += atomic_load_explicit(&p_counters->wait_buckets[i], memory_order_relaxed);
+}
+
+static void _event_metrics_counters(_event_metrics_buf_t* p_out, const char* prefix, _event_metrics_totals_t* p_totals, size_t c_totals) {
+    static const struct {
+        const char* name;
+        const char* help;
+        size_t offset;
+    } counters[] = {
+        {"signals", "Calls to event_signal.", offsetof(_event_metrics_totals_t, signals)},
+        {"waits", "Completed waits.", offsetof(_event_metrics_totals_t, waits)},
+        {"timeouts", "Waits that timed out.", offsetof(_event_metrics_totals_t, timeouts)},
+        {"contended_locks", "Event lock acquisitions that had to block.", offsetof(_event_metrics_totals_t, contended)},
+    };
+    char metric[64];
+
+    for (size_t i = 0; i < sizeof(counters) / sizeof(*counters); ++i) {
+        _event_metrics_printf(p_out, "# TYPE %s_%s counter\n# HELP %s_%s %s\n", prefix, counters[i].name, prefix, counters[i].name, counters[i].help);
+        snprintf(metric, sizeof(metric), "%s_%s_total", prefix, counters[i].name);
+
+        for (size_t j = 0; j < c_totals; ++j)
+            _event_metrics_sample(p_out, metric, p_totals[j].name, *(const uint_least64_t*)((const char*)&p_totals[j] + counters[i].offset));
+    }
+
+    _event_metrics_printf(p_out, "# TYPE %s_wait_seconds histogram\n# HELP %s_wait_seconds Time spent in event_wait and event_wait_multiple.\n", prefix, prefix);
+    snprintf(metric, sizeof(metric), "%s_wait_seconds", prefix);
+
+    for (size_t j = 0; j < c_totals; ++j)
+        _event_metrics_histogram(p_out, metric, p_totals[j].name, p_totals[j].wait_buckets, p_totals[j].wait_ns);
+}
+
+event_error_t event_metrics_write(char* p_buf, size_t c_buf, size_t* p_len) {
+    if (!p_buf && c_buf)
+        return EINVAL;
+
+    _event_metrics_buf_t out = {p_buf, c_buf, 0};
+    _event_metrics_totals_t global = {0};
+    _event_metrics_totals_t* p_named = NULL;
+    size_t c_named = 0;
+    size_t cap_named = 0;
+    int err = 0;
+
+    _event_metrics_add(&global, &_event_metrics_global);
+    _event_metrics_counters(&out, "events", &global, 1);
+
+    _event_metrics_printf(&out, "# TYPE events_helper_threads counter\n# HELP events_helper_threads Helper threads spawned by event_wait_multiple.\n");
+    _event_metrics_sample(&out, "events_helper_threads_total", NULL, atomic_load_explicit(&_event_metrics_helpers, memory_order_relaxed));
+
+    call_once(&_event_names_once, _event_names_init);
+    CHECK_THRD_ERR(mtx_lock(&_event_names_mtx));
+
+    for (_event_name_t* p_name = _event_names; p_name; p_name = p_name->p_next)
+        ++cap_named;
+
+    if (cap_named && !(p_named = calloc(cap_named, sizeof(_event_metrics_totals_t))))
+        err = ENOMEM;
+
+    for (_event_name_t* p_name = _event_names; p_name && !err; p_name = p_name->p_next) {
+        p_named[c_named].name = p_name->name;
+        _event_metrics_add(&p_named[c_named++], &p_name->retired);
+    }
+
+    // Events sharing a name share an interned string, so summing by pointer keeps label sets unique.
+    for (event_t* p_event = _event_metrics_events; p_event && !err; p_event = p_event->p_metrics_next) {
+        const char* name = atomic_load_explicit(&p_event->name, memory_order_relaxed);
+
+        for (size_t i = 0; i < c_named; ++i) {
+            if (p_named[i].name == name) {
+                _event_metrics_add(&p_named[i], &p_event->counters);
+                break;
+            }
+        }
+    }
+
+    CHECK_THRD_ERR(mtx_unlock(&_event_names_mtx));
+
+    if (!err) {
+        if (c_named)
+            _event_metrics_counters(&out, "events_named", p_named, c_named);
+
+        _event_metrics_printf(&out, "# EOF\n");
+
+        if (out.len >= c_buf)
+            err = ENOSPC;
+    }
+
+    free(p_named);
+
+    if (p_len)
+        *p_len = out.len;
+
+    return err;
+}
+#else
+event_error_t event_metrics_write(char* p_buf, size_t c_buf, size_t* p_len) {
+    (void)p_buf;
+    (void)c_buf;
+
+    if (p_len)
+        *p_len = 0;
+
+    return ENOTSUP;
+}
+#endif
+
+#ifdef EVENTS_WATCHDOG
+event_error_t event_watchdog_scan(uint64_t threshold_ns, event_stall_t* p_stalls, size_t c_stalls, size_t* p_c_found) {
+    if ((!p_stalls && c_stalls) || !p_c_found)
+        return EINVAL;
+
+    uint_least64_t now_ns = _event_now_ns();
+    size_t c_found = 0;
+
+    for (_event_blocked_t* p_slot = atomic_load_explicit(&_event_blocked_slots, memory_order_acquire); p_slot; p_slot = p_slot->p_next) {
+        event_stall_t stalls[EVENT_WATCHDOG_MAX_EVENTS];
+        size_t c_events;
+        unsigned seq;
+
+        do {
+            while ((seq = atomic_load_explicit(&p_slot->seq, memory_order_acquire)) & 1)
+                thrd_yield();
+
+            uint_least64_t start_ns = atomic_load_explicit(&p_slot->start_ns, memory_order_relaxed);
+            bool wait_all = atomic_load_explicit(&p_slot->wait_all, memory_order_relaxed);
+            c_events = atomic_load_explicit(&p_slot->c_events, memory_order_relaxed);
+            if (c_events > EVENT_WATCHDOG_MAX_EVENTS)
+                c_events = EVENT_WATCHDOG_MAX_EVENTS;
+
+            for (size_t i = 0; i < c_events; ++i) {
+                stalls[i].p_event = atomic_load_explicit(&p_slot->p_events[i], memory_order_relaxed);
+                stalls[i].name = atomic_load_explicit(&p_slot->names[i], memory_order_relaxed);
+                stalls[i].thread_id = p_slot->thread_id;
+                stalls[i].last_signaler_id = 0;
+                stalls[i].blocked_ns = now_ns > start_ns ? now_ns - start_ns : 0;
+                stalls[i].wait_all = wait_all;
+            }
+
+            atomic_thread_fence(memory_order_acquire);
+        } while (atomic_load_explicit(&p_slot->seq, memory_order_relaxed) != seq);
+
+        if (!c_events || stalls[0].blocked_ns < threshold_ns)
+            continue;
+
+        for (size_t i = 0; i < c_events; ++i) {
+            if (stalls[i].p_event)
+                stalls[i].last_signaler_id = _event_signaler_get(stalls[i].p_event);
+        }
+
+        for (size_t i = 0; i < c_events; ++i, ++c_found) {
+            if (c_found < c_stalls)
+                p_stalls[c_found] = stalls[i];
+        }
+    }
+
+    *p_c_found = c_found;
+    return 0;
+}
+
+typedef struct _event_watchdog_t {
+    thrd_t thrd;
+    event_t* p_stop;
+    uint64_t threshold_ns;
+    uint64_t interval_ns;
+    event_stall_fn_t fn;
+    void* ctx;
+} _event_watchdog_t;
+
+static mtx_t _event_watchdog_mtx;
+static once_flag _event_watchdog_once = ONCE_FLAG_INIT;
+static _event_watchdog_t* _event_watchdog;
+
+static void _event_watchdog_init(void) {
+    CHECK_THRD_ERR(mtx_init(&_event_watchdog_mtx, mtx_plain));
+}
+
+static int _event_watchdog_thread(_event_watchdog_t* p_watchdog) {
+    event_stall_t stalls[64];
+    struct timespec deadline;
+
+    // The watchdog's own sleep is not a stall.
+    _event_blocked_ignore = true;
+
+    timespec_get(&deadline, TIME_UTC);
+
+    for (;;) {
+        deadline.tv_sec += (time_t)(p_watchdog->interval_ns / 1000000000u);
+        deadline.tv_nsec += (long)(p_watchdog->interval_ns % 1000000000u);
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_nsec -= 1000000000;
+            ++deadline.tv_sec;
+        }
+
+        if (event_wait(p_watchdog->p_stop, &deadline) != ETIMEDOUT)
+            return 0;
+
+        size_t c_found;
+        if (event_watchdog_scan(p_watchdog->threshold_ns, stalls, sizeof(stalls) / sizeof(*stalls), &c_found))
+            continue;
+
+        for (size_t i = 0; i < c_found && i < sizeof(stalls) / sizeof(*stalls); ++i)
+            p_watchdog->fn(&stalls[i], p_watchdog->ctx);
+    }
+}
+
+event_error_t event_watchdog_start(uint64_t threshold_ns, uint64_t interval_ns, event_stall_fn_t fn, void* ctx) {
+    if (!fn || !interval_ns)
+        return EINVAL;
+
+    call_once(&_event_watchdog_once, _event_watchdog_init);
+    CHECK_THRD_ERR(mtx_lock(&_event_watchdog_mtx));
+
+    int err = 0;
+    _event_watchdog_t* p_watchdog = NULL;
+
+    if (_event_watchdog) {
+        err = EBUSY;
+        goto unlock;
+    }
+
+    if (!(p_watchdog = calloc(1, sizeof(_event_watchdog_t))) || !(p_watchdog->p_stop = malloc(sizeof(event_t)))) {
+        err = ENOMEM;
+        goto free_watchdog;
+    }
+
+    if ((err = event_init(p_watchdog->p_stop, true, false)))
+        goto free_watchdog;
+
+    p_watchdog->threshold_ns = threshold_ns;
+    p_watchdog->interval_ns = interval_ns;
+    p_watchdog->fn = fn;
+    p_watchdog->ctx = ctx;
+
+    if ((err = _thrd_status_to_errno(thrd_create(&p_watchdog->thrd, (thrd_start_t)_event_watchdog_thread, p_watchdog)))) {
+        event_destroy(p_watchdog->p_stop);
+        goto free_watchdog;
+    }
+
+    _event_watchdog = p_watchdog;
+    goto unlock;
+
+free_watchdog:
+    if (p_watchdog)
+        free(p_watchdog->p_stop);
+    free(p_watchdog);
+
+unlock:
+    CHECK_THRD_ERR(mtx_unlock(&_event_watchdog_mtx));
+    return err;
+}
+
+void event_watchdog_stop(void) {
+    call_once(&_event_watchdog_once, _event_watchdog_init);
+    CHECK_THRD_ERR(mtx_lock(&_event_watchdog_mtx));
+
+    _event_watchdog_t* p_watchdog = _event_watchdog;
+    _event_watchdog = NULL;
+
+    if (p_watchdog) {
+        event_signal(p_watchdog->p_stop);
+        thrd_join(p_watchdog->thrd, NULL);
+        event_destroy(p_watchdog->p_stop);
+        free(p_watchdog->p_stop);
+        free(p_watchdog);
+    }
+
+    CHECK_THRD_ERR(mtx_unlock(&_event_watchdog_mtx));
+}
+
+static int _event_write_dot_string(FILE* p_file, const char* str) {
+    if (fputc('"', p_file) == EOF)
+        return EIO;
+
+    for (; *str; ++str) {
+        if ((*str == '"' || *str == '\\') && fputc('\\', p_file) == EOF)
+            return EIO;
+
+        if (fputc(*str == '\n' ? ' ' : *str, p_file) == EOF)
+            return EIO;
+    }
+
+    if (fputc('"', p_file) == EOF)
+        return EIO;
+
+    return 0;
+}
+
+event_error_t event_wait_graph_write(FILE* p_file) {
+    if (!p_file)
+        return EINVAL;
+
+    event_stall_t* p_edges = NULL;
+    size_t c_edges = 0;
+    size_t c_found;
+    int err;
+
+    // Waits may start between the two scans, so retry until the snapshot fits.
+    while (!(err = event_watchdog_scan(0, p_edges, c_edges, &c_found)) && c_found > c_edges) {
+        event_stall_t* p_grown = realloc(p_edges, (c_found + 16) * sizeof(event_stall_t));
+        if (!p_grown) {
+            err = ENOMEM;
+            break;
+        }
+
+        p_edges = p_grown;
+        c_edges = c_found + 16;
+    }
+
+    if (!err && fputs("digraph events {\n", p_file) == EOF)
+        err = EIO;
+
+    for (size_t i = 0; i < c_found && !err; ++i) {
+        event_stall_t* p_edge = &p_edges[i];
+
+        // Events are drawn as boxes, threads as ellipses. Solid edges point from a waiting thread to the events it
+        // waits on (bold for wait_all), dashed edges from an event to the thread that signaled it last.
+        if (fprintf(p_file, "  \"E%p\" [shape=box,label=", (const void*)p_edge->p_event) < 0 ||
+            _event_write_dot_string(p_file, p_edge->name ? p_edge->name : "(unnamed)") ||
+            fprintf(p_file, "];\n  \"T%lu\" -> \"E%p\" [label=\"%ju ms\"%s];\n", p_edge->thread_id, (const void*)p_edge->p_event,
+                    (uintmax_t)(p_edge->blocked_ns / 1000000), p_edge->wait_all ? ",style=bold" : "") < 0)
+            err = EIO;
+
+        if (!err && p_edge->last_signaler_id &&
+            fprintf(p_file, "  \"E%p\" -> \"T%lu\" [style=dashed,label=\"last signaled by\"];\n", (const void*)p_edge->p_event, p_edge->last_signaler_id) < 0)
+            err = EIO;
+    }
+
+    if (!err && fputs("}\n", p_file) == EOF)
+        err = EIO;
+
+    free(p_edges);
+    return err;
+}
+#else
+event_error_t event_watchdog_scan(uint64_t threshold_ns, event_stall_t* p_stalls, size_t c_stalls, size_t* p_c_found) {
+    (void)threshold_ns;
+    (void)p_stalls;
+    (void)c_stalls;
+
+    if (p_c_found)
+        *p_c_found = 0;
+
+    return ENOTSUP;
+}
+
+event_error_t event_watchdog_start(uint64_t threshold_ns, uint64_t interval_ns, event_stall_fn_t fn, void* ctx) {
+    (void)threshold_ns;
+    (void)interval_ns;
+    (void)fn;
+    (void)ctx;
+    return ENOTSUP;
+}
+
+void event_watchdog_stop(void) {
+}
+
+event_error_t event_wait_graph_write(FILE* p_file) {
+    (void)p_file;
+    return ENOTSUP;
+}
+#endif
+
+#ifdef EVENTS_FAULT_INJECTION
+event_error_t event_fault_set(event_fault_point_t point, const event_fault_t* p_fault) {
+    if ((unsigned)point >= EVENT_FAULT_POINT_COUNT || (p_fault && (p_fault->probability_ppm > 1000000u || p_fault->min_delay_ns > p_fault->max_delay_ns)))
+        return EINVAL;
+
+    _event_fault_config_t* p_config = &_event_faults[point];
+
+    // Disable first so that a concurrent injection never pairs the new probability with old delays for long.
+    atomic_store_explicit(&p_config->probability_ppm, 0, memory_order_relaxed);
+
+    if (p_fault) {
+        atomic_store_explicit(&p_config->min_delay_ns, p_fault->min_delay_ns, memory_order_relaxed);
+        atomic_store_explicit(&p_config->max_delay_ns, p_fault->max_delay_ns, memory_order_relaxed);
+        atomic_store_explicit(&p_config->probability_ppm, p_fault->probability_ppm, memory_order_relaxed);
+    }
+
+    return 0;
+}
+
+event_error_t event_fault_get_count(event_fault_point_t point, uint64_t* p_count) {
+    if ((unsigned)point >= EVENT_FAULT_POINT_COUNT || !p_count)
+        return EINVAL;
+
+    *p_count = atomic_load_explicit(&_event_faults[point].count, memory_order_relaxed);
+    return 0;
+}
+#else
+event_error_t event_fault_set(event_fault_point_t point, const event_fault_t* p_fault) {
+    (void)point;
+    (void)p_fault;
+    return ENOTSUP;
+}
+
+event_error_t event_fault_get_count(event_fault_point_t point, uint64_t* p_count) {
+    (void)point;
+    (void)p_count;
+    return ENOTSUP;
+}
+#endif
@@ -1,35 +1,380 @@
-// SPDX-FileCopyrightText: 2022 Oliver Old <oliver.old@outlook.com>
-// SPDX-License-Identifier: MIT
-
-#include <stddef.h>
-#include <stdbool.h>
-#include <time.h>
-
-typedef struct _event_t event_t;
-typedef int event_error_t;
-
-// Get size of event_t.
-size_t event_get_size(void);
-
-// Initialize an event_t.
-// The event resets after it was waited on unless 'is_manual_reset' is true.
-event_error_t event_init(event_t* p_event, bool is_manual_reset, bool initial_state);
-// Destroy the event_t.
-void event_destroy(event_t* p_event);
-
-// Set event_t to signaled.
-event_error_t event_signal(event_t* p_event);
-// Reset event_t to unsignaled.
-event_error_t event_reset(event_t* p_event);
-// Set event_t to signaled, then reset event_t to unsignaled.
-event_error_t event_pulse(event_t* p_event);
-
-// Wait on one event_t.
-// Wait until '*p_time' if 'p_time' is not null, else wait indefinitely. Returns ETIMEDOUT if time expired.
-event_error_t event_wait(event_t* p_event, const struct timespec* p_time);
-// Wait on multiple event_t.
-// 'p_events' is a pointer to an array of event_t*. 'c_events' is the amount of event_t*.
-// Waits for one signaled event or for all events to become signaled if 'wait_all' is true.
-// Wait until '*p_time' if 'p_time' is not null, else wait indefinitely. Returns ETIMEDOUT if time expired.
-// 'p_idx_signaled_event' is a *required* out pointer for the index of the signaled event if 'wait_all' is false.
-event_error_t event_wait_multiple(event_t** p_events, size_t c_events, bool wait_all, const struct timespec* p_time, size_t* p_idx_signaled_event);
+// SPDX-FileCopyrightText: 2022 Oliver Old <oliver.old@outlook.com>
+// SPDX-License-Identifier: MIT
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+typedef struct _event_t event_t;
+typedef int event_error_t;
+
+// Maximum length of an event name including the terminating null character.
+#define EVENT_NAME_MAX 32
+
+// Get size of event_t.
+size_t event_get_size(void);
+
+// Memory used by events and waits in this build, for capacity planning.
+typedef struct event_footprint_t {
+    // Synchronization backend the figures apply to, e.g. "c11".
+    const char* backend;
+    // Bytes per event_t, including its mutex and condition variable. The backend allocates nothing else per event;
+    // futex-based backends only hold kernel state for a thread while it is blocked.
+    size_t event_bytes;
+    // Heap bytes per distinct event name, interned on first use and never freed.
+    size_t name_bytes;
+    // Heap bytes per event of an outstanding event_wait_multiple call, plus 'wait_all_bytes' more per event when
+    // waiting for all. event_wait allocates nothing.
+    size_t wait_multiple_bytes;
+    size_t wait_all_bytes;
+    // Virtual bytes per event of an outstanding event_wait_multiple call for the stack mapping of its helper thread,
+    // including the guard page. The thread descriptor and static TLS are placed inside it, and helpers allocate no
+    // heap. Stacks come from a cache. 0 if helpers use the thread library's default stack.
+    size_t helper_stack_bytes;
+    // Resident bytes of the most used stack in the helper stack cache, counted page by page when this is called; 0
+    // until a helper returned its stack to the cache. Only the pages a helper touched become resident. Kernel memory
+    // per helper thread, such as its kernel stack, is not visible to the process and not included.
+    size_t helper_resident_bytes;
+    // Heap bytes per thread using the trace ring or watchdog instrumentation, allocated on first use, never freed.
+    size_t thread_bytes;
+    // Static bytes of the profile, metrics, watchdog and fault injection tables.
+    size_t static_bytes;
+} event_footprint_t;
+
+// Fill '*p_footprint' for the backend and instrumentation this library was built with.
+event_error_t event_get_footprint(event_footprint_t* p_footprint);
+
+// Initialize an event_t.
+// The event resets after it was waited on unless 'is_manual_reset' is true.
+event_error_t event_init(event_t* p_event, bool is_manual_reset, bool initial_state);
+// Destroy the event_t.
+void event_destroy(event_t* p_event);
+
+// Label event_t for stats, trace and profiling output. Names longer than EVENT_NAME_MAX - 1 are truncated.
+// Passing null or an empty string clears the name.
+event_error_t event_set_name(event_t* p_event, const char* name);
+// Get the name of event_t, or null if it has none. The string stays valid for the lifetime of the process.
+const char* event_get_name(const event_t* p_event);
+
+// Get the id identifying the calling thread in trace, watchdog and wait graph output.
+unsigned long event_get_thread_id(void);
+
+// Set event_t to signaled.
+event_error_t event_signal(event_t* p_event);
+// Reset event_t to unsignaled.
+event_error_t event_reset(event_t* p_event);
+// Set event_t to signaled, then reset event_t to unsignaled.
+event_error_t event_pulse(event_t* p_event);
+
+// Wait on one event_t.
+// Wait until '*p_time' if 'p_time' is not null, else wait indefinitely. Returns ETIMEDOUT if time expired.
+event_error_t event_wait(event_t* p_event, const struct timespec* p_time);
+// Wait until 'predicate(ctx)' returns true, reevaluating it each time event_t is signaled. Make the predicate true,
+// then signal event_t; no extra mutex is needed. The predicate runs with the event locked, so it must be quick and
+// must not call functions on this event. Does not consume the signal of an auto-reset event, and while a thread waits
+// here every signal wakes all waiters of event_t.
+// Wait until '*p_time' if 'p_time' is not null, else wait indefinitely. Returns ETIMEDOUT if time expired.
+event_error_t event_wait_until(event_t* p_event, bool (*predicate)(void* ctx), void* ctx, const struct timespec* p_time);
+// Get the version of event_t, which every signal advances. Signals that a reset or pulse already undid still count.
+event_error_t event_get_version(const event_t* p_event, uint_least64_t* p_version);
+// Wait until the version of event_t differs from '*p_last_seen_version', then store the new version there. Returns at
+// once if it already differs, so no signal is missed between calls, even one followed by a reset. Start from
+// event_get_version. Does not consume the signal of an auto-reset event, and while a thread waits here every signal
+// wakes all waiters of event_t.
+// Wait until '*p_time' if 'p_time' is not null, else wait indefinitely. Returns ETIMEDOUT if time expired.
+event_error_t event_wait_changed(event_t* p_event, uint_least64_t* p_last_seen_version, const struct timespec* p_time);
+// Wait on multiple event_t.
+// 'p_events' is a pointer to an array of event_t*. 'c_events' is the amount of event_t*.
+// Waits for one signaled event or for all events to become signaled if 'wait_all' is true.
+// Wait until '*p_time' if 'p_time' is not null, else wait indefinitely. Returns ETIMEDOUT if time expired.
+// 'p_idx_signaled_event' is a *required* out pointer for the index of the signaled event if 'wait_all' is false.
+event_error_t event_wait_multiple(event_t** p_events, size_t c_events, bool wait_all, const struct timespec* p_time, size_t* p_idx_signaled_event);
+
+// Block until the 'size' bytes at 'addr' may no longer equal '*p_expected' and a wake function was called on 'addr',
+// or until '*p_time' if 'p_time' is not null. Returns at once if they already differ. 'size' is 1, 2, 4 or 8 and
+// 'addr' aligned to it. Like a condition variable this may return while the value is unchanged, so recheck it in a
+// loop. Returns ETIMEDOUT if time expired. Waiters park in the hashed buckets of the library's parking lot, so no
+// per-address allocation is needed.
+event_error_t event_wait_on_address(const volatile void* addr, const void* p_expected, size_t size, const struct timespec* p_time);
+// Wake one thread waiting on 'addr' in event_wait_on_address. Change the value before calling this.
+void event_wake_by_address_single(const void* addr);
+// Wake all threads waiting on 'addr' in event_wait_on_address. Change the value before calling this.
+void event_wake_by_address_all(const void* addr);
+
+// One-word mutex on the same parking lot. Locking uncontended is a single compare-and-swap; threads only park when the
+// mutex stays locked after spinning briefly. Not recursive. Zero-initialized or EVENT_MUTEX_INIT is unlocked, and
+// there is nothing to destroy.
+typedef struct event_mutex_t {
+    atomic_uint state;
+} event_mutex_t;
+
+#define EVENT_MUTEX_INIT {0}
+
+// Initialize an event_mutex_t as unlocked.
+void event_mutex_init(event_mutex_t* p_mutex);
+// Lock event_mutex_t, waiting as long as it takes.
+event_error_t event_mutex_lock(event_mutex_t* p_mutex);
+// Lock event_mutex_t, waiting until '*p_time' if 'p_time' is not null, else indefinitely. Returns ETIMEDOUT if time
+// expired.
+event_error_t event_mutex_timedlock(event_mutex_t* p_mutex, const struct timespec* p_time);
+// Lock event_mutex_t if that does not require waiting. Returns EBUSY if it is locked.
+event_error_t event_mutex_trylock(event_mutex_t* p_mutex);
+// Unlock event_mutex_t locked by the calling thread.
+event_error_t event_mutex_unlock(event_mutex_t* p_mutex);
+
+// One-word reader-writer lock on the same parking lot. Uncontended read and write locking is a single compare-and-swap.
+// Waiting writers hold back new readers, so writers are not starved. Zero-initialized or EVENT_RWLOCK_INIT is
+// unlocked, and there is nothing to destroy.
+typedef struct event_rwlock_t {
+    atomic_uint state;
+} event_rwlock_t;
+
+#define EVENT_RWLOCK_INIT {0}
+
+// Initialize an event_rwlock_t as unlocked.
+void event_rwlock_init(event_rwlock_t* p_rwlock);
+// Lock event_rwlock_t shared, waiting as long as it takes.
+event_error_t event_rwlock_read_lock(event_rwlock_t* p_rwlock);
+// Lock event_rwlock_t shared if that does not require waiting. Returns EBUSY otherwise.
+event_error_t event_rwlock_try_read_lock(event_rwlock_t* p_rwlock);
+// Release a shared lock of event_rwlock_t.
+event_error_t event_rwlock_read_unlock(event_rwlock_t* p_rwlock);
+// Lock event_rwlock_t exclusively, waiting as long as it takes.
+event_error_t event_rwlock_write_lock(event_rwlock_t* p_rwlock);
+// Lock event_rwlock_t exclusively if that does not require waiting. Returns EBUSY otherwise.
+event_error_t event_rwlock_try_write_lock(event_rwlock_t* p_rwlock);
+// Release the exclusive lock of event_rwlock_t.
+event_error_t event_rwlock_write_unlock(event_rwlock_t* p_rwlock);
+
+// Cell holding the latest published value of a fixed size. Readers copy it out without locks, validated by a sequence
+// counter, and can wait for a newer version. Publishing wakes waiters only if there are any. Allocate
+// event_watch_get_size(size) bytes, aligned like max_align_t, and initialize with event_watch_init.
+typedef struct _event_watch_t event_watch_t;
+
+// Get size of event_watch_t holding a value of 'size' bytes, or 0 if that size does not fit in a size_t.
+size_t event_watch_get_size(size_t size);
+// Initialize an event_watch_t holding a value of 'size' bytes, copied from 'p_initial', or zeroed if it is null. The
+// initial value is version 0. Returns EINVAL if event_watch_get_size(size) is 0.
+event_error_t event_watch_init(event_watch_t* p_watch, const void* p_initial, size_t size);
+// Destroy the event_watch_t. No thread may be using it.
+void event_watch_destroy(event_watch_t* p_watch);
+// Replace the value of event_watch_t with the value at 'p_value', advance its version and wake all waiters.
+// Publishers are serialized; readers are never blocked, but retry their copy if it overlapped a publish.
+event_error_t event_watch_publish(event_watch_t* p_watch, const void* p_value);
+// Copy the latest value of event_watch_t to 'p_value' and, if 'p_version' is not null, its version to '*p_version'.
+event_error_t event_watch_read(const event_watch_t* p_watch, void* p_value, uint_least64_t* p_version);
+// Wait until the version of event_watch_t differs from '*p_last_seen_version', then store the new version there and
+// copy the value to 'p_value' unless it is null. Returns at once if a newer version is already published. Versions
+// published in between are skipped; only the latest value is kept.
+// Wait until '*p_time' if 'p_time' is not null, else wait indefinitely. Returns ETIMEDOUT if time expired.
+event_error_t event_watch_wait(event_watch_t* p_watch, uint_least64_t* p_last_seen_version, void* p_value, const struct timespec* p_time);
+
+// Double-buffered snapshot of a fixed size. A single writer at a time fills the back buffer in place and flips it to
+// the front; readers copy the front buffer without locks and retry if a flip overlapped their copy. Waiters are only
+// woken by flips. Allocate event_snapshot_get_size(size) bytes, aligned like max_align_t, and initialize with
+// event_snapshot_init.
+typedef struct _event_snapshot_t event_snapshot_t;
+
+// Get size of event_snapshot_t holding snapshots of 'size' bytes, or 0 if that size does not fit in a size_t.
+size_t event_snapshot_get_size(size_t size);
+// Initialize an event_snapshot_t holding snapshots of 'size' bytes, with both buffers copied from 'p_initial', or
+// zeroed if it is null. The initial snapshot is version 0. Returns EINVAL if event_snapshot_get_size(size) is 0.
+event_error_t event_snapshot_init(event_snapshot_t* p_snapshot, const void* p_initial, size_t size);
+// Destroy the event_snapshot_t. No thread may be using it.
+void event_snapshot_destroy(event_snapshot_t* p_snapshot);
+// Start writing the next snapshot of event_snapshot_t, waiting for any other writer. '*pp_back' receives the back
+// buffer, aligned like max_align_t, which holds the snapshot from before the last flip, or a copy of the current one if
+// 'copy_front' is true. Finish with event_snapshot_publish or event_snapshot_cancel_write.
+event_error_t event_snapshot_begin_write(event_snapshot_t* p_snapshot, bool copy_front, void** pp_back);
+// Flip the back buffer of event_snapshot_t to the front, advance its version and wake all waiters.
+event_error_t event_snapshot_publish(event_snapshot_t* p_snapshot);
+// Stop writing event_snapshot_t without publishing. The back buffer keeps whatever was written to it.
+event_error_t event_snapshot_cancel_write(event_snapshot_t* p_snapshot);
+// Copy the current snapshot of event_snapshot_t to 'p_value' and, if 'p_version' is not null, its version to
+// '*p_version'.
+event_error_t event_snapshot_read(const event_snapshot_t* p_snapshot, void* p_value, uint_least64_t* p_version);
+// Wait until the version of event_snapshot_t differs from '*p_last_seen_version', then store the new version there
+// and copy the snapshot to 'p_value' unless it is null. Returns at once if a newer snapshot is already published.
+// Wait until '*p_time' if 'p_time' is not null, else wait indefinitely. Returns ETIMEDOUT if time expired.
+event_error_t event_snapshot_wait(event_snapshot_t* p_snapshot, uint_least64_t* p_last_seen_version, void* p_value, const struct timespec* p_time);
+
+// Group commit: concurrent callers submit items, the first caller of a batch becomes its leader and runs one batched
+// operation, e.g. an fsync, for all items, and the other callers wait for it and share its result. While a leader
+// runs, newly submitted items collect in the next batch, whose leader starts as soon as the previous one finishes.
+// Allocate event_group_commit_get_size() bytes and initialize with event_group_commit_init.
+typedef struct _event_group_commit_t event_group_commit_t;
+// Batched operation for the 'c_items' items at 'p_items', in submission order. Its result is returned to every caller
+// of the batch. Runs on the leader's thread without locks held.
+typedef int (*event_group_commit_fn_t)(void* ctx, void* const* p_items, size_t c_items);
+
+// Get size of event_group_commit_t.
+size_t event_group_commit_get_size(void);
+// Initialize an event_group_commit_t that commits batches with 'fn', passing it 'ctx'.
+event_error_t event_group_commit_init(event_group_commit_t* p_group, event_group_commit_fn_t fn, void* ctx);
+// Destroy the event_group_commit_t. No submit may be in progress.
+void event_group_commit_destroy(event_group_commit_t* p_group);
+// Add 'item' to the next batch of event_group_commit_t and return once that batch was committed, storing the result
+// of the batched operation in '*p_result'. Returns ENOMEM if the item could not be added. If the batch's leader fails
+// to wait for the previous commit, the batch is not committed and its callers get that error code as the result.
+event_error_t event_group_commit_submit(event_group_commit_t* p_group, void* item, int* p_result);
+
+// Single-flight table: of concurrent callers asking for the same key, only the first computes the value and the others
+// wait for it and receive the same value. A key is only deduplicated while its computation runs; later callers compute
+// again. Allocate event_single_flight_get_size() bytes and initialize with event_single_flight_init.
+typedef struct _event_single_flight_t event_single_flight_t;
+// Compute the value for a key. Runs on the first caller's thread without locks held.
+typedef void* (*event_single_flight_fn_t)(void* ctx);
+
+// Get size of event_single_flight_t.
+size_t event_single_flight_get_size(void);
+// Initialize an event_single_flight_t.
+event_error_t event_single_flight_init(event_single_flight_t* p_flights);
+// Destroy the event_single_flight_t. No call may be in progress.
+void event_single_flight_destroy(event_single_flight_t* p_flights);
+// Store in '*p_value' the value for the 'key_size' bytes at 'key', computed by 'fn(ctx)' unless a computation for an
+// equal key is in progress, in which case wait for that one instead. '*p_shared', if 'p_shared' is not null, is set
+// to whether other callers received the same value, which matters if it must be freed. Returns ENOMEM if the
+// computation could not be registered.
+event_error_t event_single_flight_do(event_single_flight_t* p_flights, const void* key, size_t key_size, event_single_flight_fn_t fn, void* ctx, void** p_value, bool* p_shared);
+
+// Batch trigger: producers count items in with a lock-free add, and the consumer is woken once the batch reaches a
+// size or a delay has passed since its first item, whichever comes first. Producers wake the consumer at most twice
+// per batch, never per item. Allocate event_batch_get_size() bytes and initialize with event_batch_init.
+typedef struct _event_batch_t event_batch_t;
+
+// Get size of event_batch_t.
+size_t event_batch_get_size(void);
+// Initialize an event_batch_t that is due once it holds 'c_max' items or '*p_max_delay' after its first item.
+event_error_t event_batch_init(event_batch_t* p_batch, size_t c_max, const struct timespec* p_max_delay);
+// Destroy the event_batch_t. No thread may be using it.
+void event_batch_destroy(event_batch_t* p_batch);
+// Count 'c_items' more items into event_batch_t, after making them available to the consumer.
+event_error_t event_batch_add(event_batch_t* p_batch, size_t c_items);
+// Take all pending items of event_batch_t without waiting, e.g. to flush on shutdown. '*p_c_items' may be 0.
+event_error_t event_batch_take(event_batch_t* p_batch, size_t* p_c_items);
+// Wait until event_batch_t is due, then take all its pending items, storing their number in '*p_c_items'.
+// Wait until '*p_time' if 'p_time' is not null, else wait indefinitely. Returns ETIMEDOUT if time expired, leaving
+// pending items for the next call.
+event_error_t event_batch_wait(event_batch_t* p_batch, size_t* p_c_items, const struct timespec* p_time);
+
+// Preallocate stacks for 'c_stacks' concurrent event_wait_multiple helper threads, one per event waited on, and keep
+// at least that many cached. Helpers otherwise allocate stacks on first use and cache a limited number.
+// Returns ENOTSUP where helpers cannot be given custom stacks and use the thread library's default.
+event_error_t event_reserve_helper_stacks(size_t c_stacks);
+
+// Write the per-call-site wait profile to 'p_file', sorted by total blocked time.
+// Call sites are return addresses of event_wait/event_wait_multiple callers; resolve them with addr2line.
+// Returns ENOTSUP unless built with EVENTS_PROFILE.
+event_error_t event_profile_dump(FILE* p_file);
+// Clear the accumulated wait profile and phase timings. Call sites stay registered.
+void event_profile_reset(void);
+
+// Phases of event_wait_multiple, timed separately under EVENTS_PROFILE. A wait for all events that finds one of them
+// reset again restarts at EVENT_PHASE_SPAWN, so spawn through join can be counted more than once per call. A call whose
+// setup fails counts the failed attempt, including joining the helpers already started, in the phase that failed.
+typedef enum event_phase_t {
+    // Waiter array and, when waiting for all, the sorted lock order.
+    EVENT_PHASE_ALLOC,
+    // Wait info mutex and condition variable.
+    EVENT_PHASE_INIT,
+    // One helper thread per event.
+    EVENT_PHASE_SPAWN,
+    // Until a helper reports back or time expires, including joining that helper.
+    EVENT_PHASE_RENDEZVOUS,
+    // Waking helpers that are still blocked.
+    EVENT_PHASE_CANCEL,
+    // Joining the remaining helpers.
+    EVENT_PHASE_JOIN,
+    // Destroying the wait info and freeing.
+    EVENT_PHASE_TEARDOWN,
+    EVENT_PHASE_COUNT
+} event_phase_t;
+
+typedef struct event_phase_stats_t {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+} event_phase_stats_t;
+
+// Copy the accumulated event_wait_multiple phase timings into 'p_stats', an array indexed by event_phase_t with
+// EVENT_PHASE_COUNT entries. Returns ENOTSUP unless built with EVENTS_PROFILE.
+event_error_t event_profile_get_phases(event_phase_stats_t* p_stats);
+// Get the short name of a phase, e.g. "spawn", or null if 'phase' is out of range.
+const char* event_phase_get_name(event_phase_t phase);
+
+// Write the events recorded by every thread as Chrome trace JSON (chrome://tracing, ui.perfetto.dev) to 'p_file'.
+// Each thread keeps its most recent signal, reset, wait and timeout records in its own ring buffer.
+// Returns ENOTSUP unless built with EVENTS_TRACE.
+event_error_t event_trace_write(FILE* p_file);
+
+// Serialize global and per-name counters (signals, waits, timeouts, contended locks, wait_multiple helper threads
+// and wait time histograms) as OpenMetrics text into 'p_buf', null-terminated. '*p_len' receives the text length;
+// returns ENOSPC if 'c_buf' is not larger than that, so callers can retry with a bigger buffer.
+// Returns ENOTSUP unless built with EVENTS_METRICS.
+event_error_t event_metrics_write(char* p_buf, size_t c_buf, size_t* p_len);
+
+// A thread blocked waiting on an event.
+typedef struct event_stall_t {
+    // Only for identification; the event may have been destroyed since.
+    const event_t* p_event;
+    const char* name;
+    unsigned long thread_id;
+    // Thread that signaled the event last, or 0 if it was never signaled.
+    unsigned long last_signaler_id;
+    uint64_t blocked_ns;
+    // Whether the thread waits for all of its events rather than any of them.
+    bool wait_all;
+} event_stall_t;
+
+typedef void (*event_stall_fn_t)(const event_stall_t* p_stall, void* ctx);
+
+// Find waits blocked for at least 'threshold_ns'. Fills up to 'c_stalls' entries of 'p_stalls', one per event
+// waited on, and stores the total number found in '*p_c_found'. A threshold of 0 snapshots every blocked wait.
+// Returns ENOTSUP unless built with EVENTS_WATCHDOG.
+event_error_t event_watchdog_scan(uint64_t threshold_ns, event_stall_t* p_stalls, size_t c_stalls, size_t* p_c_found);
+// Start a background thread calling 'fn' every 'interval_ns' for each wait blocked for at least 'threshold_ns'.
+// Returns EBUSY if a watchdog is already running, ENOTSUP unless built with EVENTS_WATCHDOG.
+event_error_t event_watchdog_start(uint64_t threshold_ns, uint64_t interval_ns, event_stall_fn_t fn, void* ctx);
+// Stop the watchdog thread started by event_watchdog_start, if any.
+void event_watchdog_stop(void);
+
+// Write a Graphviz DOT snapshot of which thread waits on which events and which thread last signaled each.
+// A cycle between threads and events means a circular wait. Returns ENOTSUP unless built with EVENTS_WATCHDOG.
+event_error_t event_wait_graph_write(FILE* p_file);
+
+// Points in the library where EVENTS_FAULT_INJECTION builds can inject delays, to test callers against slow wakeups.
+typedef enum event_fault_point_t {
+    // In event_signal after setting the event, before waking waiters, holding the event mutex.
+    EVENT_FAULT_SIGNAL,
+    // In event_wait before the event is checked.
+    EVENT_FAULT_WAIT,
+    // In event_wait after the wait ended, before returning to the caller. Stretches timeouts too.
+    EVENT_FAULT_WAKE,
+    // In an event_wait_multiple helper thread, before it starts waiting on its event and before it reports back.
+    EVENT_FAULT_HELPER,
+    // In event_wait_multiple after spawning helper threads, before waiting for the first to report back.
+    EVENT_FAULT_WAIT_MULTIPLE,
+    EVENT_FAULT_POINT_COUNT
+} event_fault_point_t;
+
+typedef struct event_fault_t {
+    // Chance of injecting each time the point is passed, in parts per million. 0 disables the point.
+    uint32_t probability_ppm;
+    // Sleep for a uniformly random time in [min_delay_ns, max_delay_ns], or yield if 'max_delay_ns' is 0.
+    uint64_t min_delay_ns;
+    uint64_t max_delay_ns;
+} event_fault_t;
+
+// Configure fault injection at 'point'. Passing null disables the point. Takes effect for all threads immediately.
+// Returns ENOTSUP unless built with EVENTS_FAULT_INJECTION.
+event_error_t event_fault_set(event_fault_point_t point, const event_fault_t* p_fault);
+// Get how often faults were injected at 'point' so far. Returns ENOTSUP unless built with EVENTS_FAULT_INJECTION.
+event_error_t event_fault_get_count(event_fault_point_t point, uint64_t* p_count);
+
+#endif
@@ -0,0 +1,489 @@
+// SPDX-FileCopyrightText: 2022 Oliver Old <oliver.old@outlook.com>
+// SPDX-License-Identifier: MIT
+
+// Mutex and condition variable that events and waits block on, selected at build time by defining at most one of
+//   EVENTS_BACKEND_PTHREAD      pthread mutex and condition variable, timed waits on CLOCK_MONOTONIC
+//   EVENTS_BACKEND_FUTEX        one-word mutex and condition variable on Linux futexes
+//   EVENTS_BACKEND_PARKING_LOT  one-word mutex and condition variable on the parking lot below
+// and C11 <threads.h> otherwise. All functions return thrd_ status codes and take absolute TIME_UTC deadlines, like
+// cnd_timedwait, so events.c is the same for every backend. Condition variables may wake spuriously.
+// Internal to events.c.
+
+#ifndef EVENTS_BACKEND_H
+#define EVENTS_BACKEND_H
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <threads.h>
+#include <time.h>
+
+#if defined(EVENTS_BACKEND_PTHREAD) + defined(EVENTS_BACKEND_FUTEX) + defined(EVENTS_BACKEND_PARKING_LOT) > 1
+#error "define at most one EVENTS_BACKEND_*"
+#endif
+
+// Parking lot: threads park on an address in a hashed bucket and are unparked by address, so that anything blocking
+// needs no more than a word of its own. Built on C11 threads, available with every backend.
+
+// Must be a power of two.
+#define _EVENT_PARK_BUCKET_BITS 8
+#define _EVENT_PARK_BUCKETS (1u << _EVENT_PARK_BUCKET_BITS)
+
+// One per thread, linked into the bucket of the address it parks on. Never destroyed, like other per-thread state.
+typedef struct _event_parker_t {
+    struct _event_parker_t* p_next;
+    const void* addr;
+    // Guarded by the bucket mutex.
+    bool unparked;
+    bool initialized;
+    cnd_t cnd;
+} _event_parker_t;
+
+typedef struct _event_park_bucket_t {
+    mtx_t mtx;
+    _event_parker_t* p_head;
+    _event_parker_t* p_tail;
+} _event_park_bucket_t;
+
+static _event_park_bucket_t _event_park_buckets[_EVENT_PARK_BUCKETS];
+static once_flag _event_park_once = ONCE_FLAG_INIT;
+static int _event_park_status = thrd_error;
+static _Thread_local _event_parker_t _event_parker;
+
+static void _event_park_init(void) {
+    for (size_t i = 0; i < _EVENT_PARK_BUCKETS; ++i) {
+        if ((_event_park_status = mtx_init(&_event_park_buckets[i].mtx, mtx_plain)) != thrd_success)
+            return;
+    }
+}
+
+static inline _event_park_bucket_t* _event_park_bucket(const void* addr) {
+    uint_least64_t key = (uint_least64_t)(uintptr_t)addr >> 2;
+    return &_event_park_buckets[(size_t)((key * 0x9E3779B97F4A7C15u) >> (64 - _EVENT_PARK_BUCKET_BITS))];
+}
+
+// Park the calling thread on 'addr' until it is unparked or '*p_time' passes, if 'p_time' is not null. 'validate' is
+// called with the bucket locked, so no unpark can slip in between; the thread only parks if it returns true.
+// Returns thrd_success once unparked, thrd_busy if validation failed, thrd_timedout if time expired first.
+static inline int _event_park(const void* addr, bool (*validate)(void* ctx), void* ctx, const struct timespec* p_time) {
+    _event_parker_t* p_self = &_event_parker;
+    int thrd_status;
+
+    call_once(&_event_park_once, _event_park_init);
+    if (_event_park_status != thrd_success)
+        return _event_park_status;
+
+    if (!p_self->initialized) {
+        if ((thrd_status = cnd_init(&p_self->cnd)) != thrd_success)
+            return thrd_status;
+
+        p_self->initialized = true;
+    }
+
+    _event_park_bucket_t* p_bucket = _event_park_bucket(addr);
+
+    if ((thrd_status = mtx_lock(&p_bucket->mtx)) != thrd_success)
+        return thrd_status;
+
+    if (validate && !validate(ctx)) {
+        mtx_unlock(&p_bucket->mtx);
+        return thrd_busy;
+    }
+
+    p_self->p_next = NULL;
+    p_self->addr = addr;
+    p_self->unparked = false;
+
+    if (p_bucket->p_tail)
+        p_bucket->p_tail->p_next = p_self;
+    else
+        p_bucket->p_head = p_self;
+    p_bucket->p_tail = p_self;
+
+    while (!p_self->unparked) {
+        if ((thrd_status = p_time ? cnd_timedwait(&p_self->cnd, &p_bucket->mtx, p_time) : cnd_wait(&p_self->cnd, &p_bucket->mtx)) != thrd_success)
+            break;
+    }
+
+    if (p_self->unparked) {
+        thrd_status = thrd_success;
+    } else {
+        _event_parker_t* p_prev = NULL;
+
+        for (_event_parker_t* p_parker = p_bucket->p_head; p_parker != p_self; p_parker = p_parker->p_next)
+            p_prev = p_parker;
+
+        if (p_prev)
+            p_prev->p_next = p_self->p_next;
+        else
+            p_bucket->p_head = p_self->p_next;
+
+        if (p_bucket->p_tail == p_self)
+            p_bucket->p_tail = p_prev;
+    }
+
+    mtx_unlock(&p_bucket->mtx);
+    return thrd_status;
+}
+
+// Unpark up to 'c_max' threads parked on 'addr', longest parked first. Returns how many were unparked.
+static inline size_t _event_unpark(const void* addr, size_t c_max) {
+    size_t c_unparked = 0;
+
+    call_once(&_event_park_once, _event_park_init);
+    if (_event_park_status != thrd_success)
+        return 0;
+
+    _event_park_bucket_t* p_bucket = _event_park_bucket(addr);
+
+    if (mtx_lock(&p_bucket->mtx) != thrd_success)
+        return 0;
+
+    _event_parker_t* p_prev = NULL;
+    _event_parker_t* p_parker = p_bucket->p_head;
+
+    while (p_parker && c_unparked < c_max) {
+        _event_parker_t* p_next = p_parker->p_next;
+
+        if (p_parker->addr != addr) {
+            p_prev = p_parker;
+            p_parker = p_next;
+            continue;
+        }
+
+        if (p_prev)
+            p_prev->p_next = p_next;
+        else
+            p_bucket->p_head = p_next;
+
+        if (p_bucket->p_tail == p_parker)
+            p_bucket->p_tail = p_prev;
+
+        p_parker->unparked = true;
+        cnd_signal(&p_parker->cnd);
+        ++c_unparked;
+        p_parker = p_next;
+    }
+
+    mtx_unlock(&p_bucket->mtx);
+    return c_unparked;
+}
+
+typedef struct _event_park_word_t {
+    atomic_uint* p_word;
+    unsigned expected;
+} _event_park_word_t;
+
+static bool _event_park_word_validate(void* ctx) {
+    _event_park_word_t* p_wait = ctx;
+    return atomic_load_explicit(p_wait->p_word, memory_order_relaxed) == p_wait->expected;
+}
+
+// Park on 'p_word' while it is 'expected'. Returns thrd_success when unparked or if the word already differed.
+static inline int _event_park_word(atomic_uint* p_word, unsigned expected, const struct timespec* p_time) {
+    _event_park_word_t wait = {p_word, expected};
+    int thrd_status = _event_park(p_word, _event_park_word_validate, &wait, p_time);
+    return thrd_status == thrd_busy ? thrd_success : thrd_status;
+}
+
+#if defined(EVENTS_BACKEND_FUTEX) || defined(EVENTS_BACKEND_PARKING_LOT)
+#ifdef EVENTS_BACKEND_FUTEX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define _EVENT_BACKEND_NAME "futex"
+
+_Static_assert(sizeof(atomic_uint) == 4, "futex words are 32 bits");
+
+// Block while '*p_word' is 'expected', until woken, '*p_time' passes or spuriously.
+static inline int _event_word_wait(atomic_uint* p_word, unsigned expected, const struct timespec* p_time) {
+    // The bitset variant takes an absolute deadline, and on CLOCK_REALTIME which is TIME_UTC.
+    if (!syscall(SYS_futex, p_word, FUTEX_WAIT_BITSET_PRIVATE | FUTEX_CLOCK_REALTIME, expected, p_time, NULL, FUTEX_BITSET_MATCH_ANY))
+        return thrd_success;
+
+    switch (errno) {
+        case EAGAIN:
+        case EINTR:
+            return thrd_success;
+        case ETIMEDOUT:
+            return thrd_timedout;
+        default:
+            return thrd_error;
+    }
+}
+
+static inline void _event_word_wake(atomic_uint* p_word, bool all) {
+    syscall(SYS_futex, p_word, FUTEX_WAKE_PRIVATE, all ? INT32_MAX : 1, NULL, NULL, 0);
+}
+#else
+#define _EVENT_BACKEND_NAME "parking_lot"
+
+// Block while '*p_word' is 'expected', until woken or '*p_time' passes.
+static inline int _event_word_wait(atomic_uint* p_word, unsigned expected, const struct timespec* p_time) {
+    return _event_park_word(p_word, expected, p_time);
+}
+
+static inline void _event_word_wake(atomic_uint* p_word, bool all) {
+    _event_unpark(p_word, all ? SIZE_MAX : 1);
+}
+#endif
+
+// 0: unlocked, 1: locked, 2: locked and threads may be waiting.
+typedef struct _event_mtx_t {
+    atomic_uint state;
+} _event_mtx_t;
+
+// 'seq' is incremented by every signal and waiters block while it is unchanged. 'c_waiters' lets signals skip the wake
+// call when nobody waits: a waiter counts itself before reading 'seq', a signaler bumps 'seq' before reading the count,
+// so either the signaler sees the waiter or the waiter sees the new 'seq'.
+typedef struct _event_cnd_t {
+    atomic_uint seq;
+    atomic_uint c_waiters;
+} _event_cnd_t;
+
+static inline int _event_mtx_init(_event_mtx_t* p_mtx) {
+    atomic_init(&p_mtx->state, 0);
+    return thrd_success;
+}
+
+static inline void _event_mtx_destroy(_event_mtx_t* p_mtx) {
+    (void)p_mtx;
+}
+
+static inline int _event_mtx_trylock(_event_mtx_t* p_mtx) {
+    unsigned state = 0;
+    return atomic_compare_exchange_strong_explicit(&p_mtx->state, &state, 1, memory_order_acquire, memory_order_relaxed) ? thrd_success : thrd_busy;
+}
+
+static inline int _event_mtx_lock(_event_mtx_t* p_mtx) {
+    unsigned state = 0;
+    int thrd_status;
+
+    if (atomic_compare_exchange_strong_explicit(&p_mtx->state, &state, 1, memory_order_acquire, memory_order_relaxed))
+        return thrd_success;
+
+    // Having waited, take the lock as 2: other threads may still be waiting and unlock has to wake them.
+    if (state != 2)
+        state = atomic_exchange_explicit(&p_mtx->state, 2, memory_order_acquire);
+
+    while (state) {
+        if ((thrd_status = _event_word_wait(&p_mtx->state, 2, NULL)) != thrd_success)
+            return thrd_status;
+
+        state = atomic_exchange_explicit(&p_mtx->state, 2, memory_order_acquire);
+    }
+
+    return thrd_success;
+}
+
+static inline int _event_mtx_unlock(_event_mtx_t* p_mtx) {
+    if (atomic_exchange_explicit(&p_mtx->state, 0, memory_order_release) == 2)
+        _event_word_wake(&p_mtx->state, false);
+
+    return thrd_success;
+}
+
+static inline int _event_cnd_init(_event_cnd_t* p_cnd) {
+    atomic_init(&p_cnd->seq, 0);
+    atomic_init(&p_cnd->c_waiters, 0);
+    return thrd_success;
+}
+
+static inline void _event_cnd_destroy(_event_cnd_t* p_cnd) {
+    (void)p_cnd;
+}
+
+static inline int _event_cnd_timedwait(_event_cnd_t* p_cnd, _event_mtx_t* p_mtx, const struct timespec* p_time) {
+    int thrd_status;
+    int thrd_status_2;
+
+    atomic_fetch_add(&p_cnd->c_waiters, 1);
+    unsigned seq = atomic_load(&p_cnd->seq);
+
+    _event_mtx_unlock(p_mtx);
+    thrd_status = _event_word_wait(&p_cnd->seq, seq, p_time);
+    atomic_fetch_sub_explicit(&p_cnd->c_waiters, 1, memory_order_relaxed);
+    thrd_status_2 = _event_mtx_lock(p_mtx);
+
+    return thrd_status == thrd_success ? thrd_status_2 : thrd_status;
+}
+
+static inline int _event_cnd_wait(_event_cnd_t* p_cnd, _event_mtx_t* p_mtx) {
+    return _event_cnd_timedwait(p_cnd, p_mtx, NULL);
+}
+
+static inline int _event_cnd_signal(_event_cnd_t* p_cnd) {
+    atomic_fetch_add(&p_cnd->seq, 1);
+    if (atomic_load(&p_cnd->c_waiters))
+        _event_word_wake(&p_cnd->seq, false);
+    return thrd_success;
+}
+
+static inline int _event_cnd_broadcast(_event_cnd_t* p_cnd) {
+    atomic_fetch_add(&p_cnd->seq, 1);
+    if (atomic_load(&p_cnd->c_waiters))
+        _event_word_wake(&p_cnd->seq, true);
+    return thrd_success;
+}
+#elif defined(EVENTS_BACKEND_PTHREAD)
+#include <pthread.h>
+
+#define _EVENT_BACKEND_NAME "pthread"
+
+typedef pthread_mutex_t _event_mtx_t;
+typedef pthread_cond_t _event_cnd_t;
+
+static inline int _event_pthread_status(int err) {
+    switch (err) {
+        case 0:
+            return thrd_success;
+        case ETIMEDOUT:
+            return thrd_timedout;
+        case EBUSY:
+            return thrd_busy;
+        case ENOMEM:
+            return thrd_nomem;
+        default:
+            return thrd_error;
+    }
+}
+
+static inline int _event_mtx_init(_event_mtx_t* p_mtx) {
+    return _event_pthread_status(pthread_mutex_init(p_mtx, NULL));
+}
+
+static inline void _event_mtx_destroy(_event_mtx_t* p_mtx) {
+    pthread_mutex_destroy(p_mtx);
+}
+
+static inline int _event_mtx_trylock(_event_mtx_t* p_mtx) {
+    return _event_pthread_status(pthread_mutex_trylock(p_mtx));
+}
+
+static inline int _event_mtx_lock(_event_mtx_t* p_mtx) {
+    return _event_pthread_status(pthread_mutex_lock(p_mtx));
+}
+
+static inline int _event_mtx_unlock(_event_mtx_t* p_mtx) {
+    return _event_pthread_status(pthread_mutex_unlock(p_mtx));
+}
+
+// Timed waits run on CLOCK_MONOTONIC, so that once a wait started, wall clock steps do not stretch or cut it short.
+static inline int _event_cnd_init(_event_cnd_t* p_cnd) {
+    pthread_condattr_t attr;
+    int err;
+
+    if ((err = pthread_condattr_init(&attr)))
+        return _event_pthread_status(err);
+
+    if (!(err = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC)))
+        err = pthread_cond_init(p_cnd, &attr);
+
+    pthread_condattr_destroy(&attr);
+    return _event_pthread_status(err);
+}
+
+static inline void _event_cnd_destroy(_event_cnd_t* p_cnd) {
+    pthread_cond_destroy(p_cnd);
+}
+
+static inline int _event_cnd_wait(_event_cnd_t* p_cnd, _event_mtx_t* p_mtx) {
+    return _event_pthread_status(pthread_cond_wait(p_cnd, p_mtx));
+}
+
+// Latest CLOCK_MONOTONIC second a timed wait blocks until, far below the limit of a 32-bit time_t.
+#define _EVENT_PTHREAD_MAX_WAIT_S ((time_t)0x7fff0000)
+
+static inline int _event_cnd_timedwait(_event_cnd_t* p_cnd, _event_mtx_t* p_mtx, const struct timespec* p_time) {
+    struct timespec now_utc;
+    struct timespec deadline;
+
+    timespec_get(&now_utc, TIME_UTC);
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    // Move the TIME_UTC deadline over to CLOCK_MONOTONIC; deadlines in the past just expire now. The remaining time is
+    // kept in seconds and saturates, so that far-future deadlines neither overflow nor wrap into the past; a wait
+    // capped this way times out after decades of monotonic uptime.
+    if (p_time->tv_sec > now_utc.tv_sec || (p_time->tv_sec == now_utc.tv_sec && p_time->tv_nsec > now_utc.tv_nsec)) {
+        time_t remaining_s = p_time->tv_sec - now_utc.tv_sec;
+        long remaining_ns = p_time->tv_nsec - now_utc.tv_nsec + deadline.tv_nsec;
+
+        if (remaining_ns < 0) {
+            remaining_ns += 1000000000;
+            --remaining_s;
+        } else if (remaining_ns >= 1000000000) {
+            remaining_ns -= 1000000000;
+            ++remaining_s;
+        }
+
+        if (remaining_s > _EVENT_PTHREAD_MAX_WAIT_S - deadline.tv_sec)
+            remaining_s = _EVENT_PTHREAD_MAX_WAIT_S - deadline.tv_sec;
+
+        deadline.tv_sec += remaining_s;
+        deadline.tv_nsec = remaining_ns;
+    }
+
+    return _event_pthread_status(pthread_cond_timedwait(p_cnd, p_mtx, &deadline));
+}
+
+static inline int _event_cnd_signal(_event_cnd_t* p_cnd) {
+    return _event_pthread_status(pthread_cond_signal(p_cnd));
+}
+
+static inline int _event_cnd_broadcast(_event_cnd_t* p_cnd) {
+    return _event_pthread_status(pthread_cond_broadcast(p_cnd));
+}
+#else
+#define _EVENT_BACKEND_NAME "c11"
+
+typedef mtx_t _event_mtx_t;
+typedef cnd_t _event_cnd_t;
+
+static inline int _event_mtx_init(_event_mtx_t* p_mtx) {
+    return mtx_init(p_mtx, mtx_plain);
+}
+
+static inline void _event_mtx_destroy(_event_mtx_t* p_mtx) {
+    mtx_destroy(p_mtx);
+}
+
+static inline int _event_mtx_trylock(_event_mtx_t* p_mtx) {
+    return mtx_trylock(p_mtx);
+}
+
+static inline int _event_mtx_lock(_event_mtx_t* p_mtx) {
+    return mtx_lock(p_mtx);
+}
+
+static inline int _event_mtx_unlock(_event_mtx_t* p_mtx) {
+    return mtx_unlock(p_mtx);
+}
+
+static inline int _event_cnd_init(_event_cnd_t* p_cnd) {
+    return cnd_init(p_cnd);
+}
+
+static inline void _event_cnd_destroy(_event_cnd_t* p_cnd) {
+    cnd_destroy(p_cnd);
+}
+
+static inline int _event_cnd_wait(_event_cnd_t* p_cnd, _event_mtx_t* p_mtx) {
+    return cnd_wait(p_cnd, p_mtx);
+}
+
+static inline int _event_cnd_timedwait(_event_cnd_t* p_cnd, _event_mtx_t* p_mtx, const struct timespec* p_time) {
+    return cnd_timedwait(p_cnd, p_mtx, p_time);
+}
+
+static inline int _event_cnd_signal(_event_cnd_t* p_cnd) {
+    return cnd_signal(p_cnd);
+}
+
+static inline int _event_cnd_broadcast(_event_cnd_t* p_cnd) {
+    return cnd_broadcast(p_cnd);
+}
+#endif
+
+#endif
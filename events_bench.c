@@ -0,0 +1,884 @@
+// SPDX-FileCopyrightText: 2022 Oliver Old <oliver.old@outlook.com>
+// SPDX-License-Identifier: MIT
+
+// Benchmarks for event_t. Linux only.
+// Build: cc -std=c11 -O2 -pthread events.c events_bench.c -o events_bench
+// Add -DEVENTS_BACKEND_PTHREAD, -DEVENTS_BACKEND_FUTEX or -DEVENTS_BACKEND_PARKING_LOT to measure another backend.
+
+#define _GNU_SOURCE
+
+#include "events.h"
+
+#include <errno.h>
+#include <linux/futex.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <threads.h>
+#include <unistd.h>
+
+// Every n-th round trip is timed individually for latency percentiles.
+#define BENCH_SAMPLE_INTERVAL 16
+#define BENCH_MAX_SAMPLES (1u << 16)
+
+// A signal/wait primitive with auto-reset event semantics.
+typedef struct bench_backend_t {
+    const char* name;
+    size_t (*get_size)(void);
+    int (*init)(void* p_obj);
+    void (*destroy)(void* p_obj);
+    int (*signal)(void* p_obj);
+    int (*wait)(void* p_obj);
+} bench_backend_t;
+
+static int events_init(void* p_obj) {
+    return event_init(p_obj, false, false);
+}
+
+static void events_destroy(void* p_obj) {
+    event_destroy(p_obj);
+}
+
+static int events_signal(void* p_obj) {
+    return event_signal(p_obj);
+}
+
+static int events_wait(void* p_obj) {
+    return event_wait(p_obj, NULL);
+}
+
+// Reference implementations of the same auto-reset semantics, to judge event_t against what Linux offers directly.
+
+typedef struct condvar_event_t {
+    pthread_mutex_t mtx;
+    pthread_cond_t cnd;
+    bool signaled;
+} condvar_event_t;
+
+static size_t condvar_get_size(void) {
+    return sizeof(condvar_event_t);
+}
+
+static int condvar_init(void* p_obj) {
+    condvar_event_t* p_event = p_obj;
+    int err;
+
+    if ((err = pthread_mutex_init(&p_event->mtx, NULL)))
+        return err;
+
+    if ((err = pthread_cond_init(&p_event->cnd, NULL))) {
+        pthread_mutex_destroy(&p_event->mtx);
+        return err;
+    }
+
+    p_event->signaled = false;
+    return 0;
+}
+
+static void condvar_destroy(void* p_obj) {
+    condvar_event_t* p_event = p_obj;
+    pthread_cond_destroy(&p_event->cnd);
+    pthread_mutex_destroy(&p_event->mtx);
+}
+
+static int condvar_signal(void* p_obj) {
+    condvar_event_t* p_event = p_obj;
+    pthread_mutex_lock(&p_event->mtx);
+    p_event->signaled = true;
+    pthread_cond_signal(&p_event->cnd);
+    pthread_mutex_unlock(&p_event->mtx);
+    return 0;
+}
+
+static int condvar_wait(void* p_obj) {
+    condvar_event_t* p_event = p_obj;
+    pthread_mutex_lock(&p_event->mtx);
+    while (!p_event->signaled)
+        pthread_cond_wait(&p_event->cnd, &p_event->mtx);
+    p_event->signaled = false;
+    pthread_mutex_unlock(&p_event->mtx);
+    return 0;
+}
+
+// 0: unsignaled, 1: signaled, 2: unsignaled with possible sleepers.
+static size_t futex_get_size(void) {
+    return sizeof(atomic_int);
+}
+
+static int futex_init(void* p_obj) {
+    atomic_init((atomic_int*)p_obj, 0);
+    return 0;
+}
+
+static void futex_destroy(void* p_obj) {
+    (void)p_obj;
+}
+
+static int futex_signal(void* p_obj) {
+    atomic_int* p_state = p_obj;
+
+    if (atomic_exchange(p_state, 1) == 2)
+        syscall(SYS_futex, p_state, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+
+    return 0;
+}
+
+static int futex_wait(void* p_obj) {
+    atomic_int* p_state = p_obj;
+    int state = 1;
+
+    if (atomic_compare_exchange_strong(p_state, &state, 0))
+        return 0;
+
+    for (;;) {
+        // Once we slept, consume into 2 since other sleepers may remain.
+        if (state == 1) {
+            if (atomic_compare_exchange_strong(p_state, &state, 2))
+                return 0;
+            continue;
+        }
+
+        if (state == 0 && !atomic_compare_exchange_strong(p_state, &state, 2))
+            continue;
+
+        syscall(SYS_futex, p_state, FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0);
+        state = atomic_load(p_state);
+    }
+}
+
+// Reading an eventfd consumes all pending signals, like an auto-reset event.
+static size_t eventfd_get_size(void) {
+    return sizeof(int);
+}
+
+static int eventfd_init(void* p_obj) {
+    int fd = eventfd(0, EFD_CLOEXEC);
+    if (fd < 0)
+        return errno;
+
+    *(int*)p_obj = fd;
+    return 0;
+}
+
+static void eventfd_destroy(void* p_obj) {
+    close(*(int*)p_obj);
+}
+
+static int eventfd_signal(void* p_obj) {
+    uint64_t value = 1;
+    return write(*(int*)p_obj, &value, sizeof(value)) == sizeof(value) ? 0 : errno;
+}
+
+static int eventfd_wait(void* p_obj) {
+    uint64_t value;
+    return read(*(int*)p_obj, &value, sizeof(value)) == sizeof(value) ? 0 : errno;
+}
+
+// Counting rather than binary, which makes no difference for ping-pong.
+static size_t semaphore_get_size(void) {
+    return sizeof(sem_t);
+}
+
+static int semaphore_init(void* p_obj) {
+    return sem_init(p_obj, 0, 0) ? errno : 0;
+}
+
+static void semaphore_destroy(void* p_obj) {
+    sem_destroy(p_obj);
+}
+
+static int semaphore_signal(void* p_obj) {
+    return sem_post(p_obj) ? errno : 0;
+}
+
+static int semaphore_wait(void* p_obj) {
+    while (sem_wait(p_obj)) {
+        if (errno != EINTR)
+            return errno;
+    }
+
+    return 0;
+}
+
+static const bench_backend_t bench_backends[] = {
+    {"events", event_get_size, events_init, events_destroy, events_signal, events_wait},
+    {"condvar", condvar_get_size, condvar_init, condvar_destroy, condvar_signal, condvar_wait},
+    {"futex", futex_get_size, futex_init, futex_destroy, futex_signal, futex_wait},
+    {"eventfd", eventfd_get_size, eventfd_init, eventfd_destroy, eventfd_signal, eventfd_wait},
+    {"semaphore", semaphore_get_size, semaphore_init, semaphore_destroy, semaphore_signal, semaphore_wait},
+};
+
+#define BENCH_BACKEND_COUNT (sizeof(bench_backends) / sizeof(*bench_backends))
+
+// Counters read with perf_event_open around each measurement, reported per round trip.
+typedef struct bench_counter_t {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+} bench_counter_t;
+
+static const bench_counter_t bench_counters[] = {
+    {"ctx_sw/rt", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {"cache_miss/rt", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"instr/rt", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cycles/rt", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+};
+
+#define BENCH_COUNTER_COUNT (sizeof(bench_counters) / sizeof(*bench_counters))
+
+typedef struct bench_options_t {
+    unsigned duration_ms;
+    bool pin;
+    bool counters;
+    const bench_backend_t* p_backend;
+} bench_options_t;
+
+// One fd per counter rather than a group, so counters the kernel or PMU does not offer are simply missing (-1).
+typedef struct bench_perf_t {
+    int fds[BENCH_COUNTER_COUNT];
+} bench_perf_t;
+
+typedef struct bench_pair_t {
+    const bench_options_t* p_options;
+    atomic_bool* p_stop;
+    // Set by the ping thread once it sent its last round trip, so the pong thread never exits with one unanswered.
+    atomic_bool ping_done;
+    unsigned cpu_ping;
+    unsigned cpu_pong;
+    // A single-thread pair signals and waits on 'p_ping' itself.
+    bool is_single;
+    void* p_ping;
+    void* p_pong;
+    thrd_t thrd_ping;
+    thrd_t thrd_pong;
+    uint64_t round_trips;
+    uint64_t* p_samples;
+    size_t c_samples;
+} bench_pair_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_u64(const void* p_lhs, const void* p_rhs) {
+    uint64_t lhs = *(const uint64_t*)p_lhs;
+    uint64_t rhs = *(const uint64_t*)p_rhs;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static uint64_t percentile(const uint64_t* p_sorted, size_t c_sorted, double p) {
+    if (!c_sorted)
+        return 0;
+
+    size_t idx = (size_t)(p / 100.0 * (double)(c_sorted - 1) + 0.5);
+    return p_sorted[idx];
+}
+
+// Open the counters disabled, for this process and every thread it creates afterwards. Kernel-side counting is
+// attempted first and dropped if perf_event_paranoid forbids it.
+static void perf_open(bench_perf_t* p_perf) {
+    for (size_t i = 0; i < BENCH_COUNTER_COUNT; ++i) {
+        struct perf_event_attr attr = {
+            .type = bench_counters[i].type,
+            .size = sizeof(attr),
+            .config = bench_counters[i].config,
+            .read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING,
+            .disabled = 1,
+            .inherit = 1,
+            .exclude_hv = 1,
+        };
+
+        p_perf->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        if (p_perf->fds[i] < 0 && (errno == EACCES || errno == EPERM)) {
+            attr.exclude_kernel = 1;
+            p_perf->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        }
+    }
+}
+
+static void perf_close(bench_perf_t* p_perf) {
+    for (size_t i = 0; i < BENCH_COUNTER_COUNT; ++i) {
+        if (p_perf->fds[i] >= 0)
+            close(p_perf->fds[i]);
+    }
+}
+
+static void perf_enable(bench_perf_t* p_perf, bool enable) {
+    for (size_t i = 0; i < BENCH_COUNTER_COUNT; ++i) {
+        if (p_perf->fds[i] >= 0)
+            ioctl(p_perf->fds[i], enable ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, 0);
+    }
+}
+
+// Read a counter after its threads were joined, which folds their counts into ours. Scales for time the PMU
+// spent multiplexing other counters. Returns false if the counter is unavailable or never ran.
+static bool perf_read(const bench_perf_t* p_perf, size_t i, double* p_value) {
+    uint64_t values[3];
+
+    if (p_perf->fds[i] < 0 || read(p_perf->fds[i], values, sizeof(values)) != sizeof(values) || !values[2])
+        return false;
+
+    *p_value = (double)values[0] * ((double)values[1] / (double)values[2]);
+    return true;
+}
+
+static unsigned online_cpus(void) {
+    long c_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return c_cpus > 0 ? (unsigned)c_cpus : 1;
+}
+
+static void pin_to_cpu(unsigned cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % online_cpus(), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static int ping(bench_pair_t* p_pair) {
+    const bench_backend_t* p_backend = p_pair->p_options->p_backend;
+    void* p_other = p_pair->is_single ? p_pair->p_ping : p_pair->p_pong;
+
+    if (p_pair->p_options->pin)
+        pin_to_cpu(p_pair->cpu_ping);
+
+    while (!atomic_load_explicit(p_pair->p_stop, memory_order_relaxed)) {
+        bool sample = p_pair->round_trips % BENCH_SAMPLE_INTERVAL == 0 && p_pair->c_samples < BENCH_MAX_SAMPLES;
+        uint64_t start_ns = sample ? now_ns() : 0;
+
+        if (p_backend->signal(p_other) || p_backend->wait(p_pair->p_ping))
+            return EXIT_FAILURE;
+
+        if (sample)
+            p_pair->p_samples[p_pair->c_samples++] = now_ns() - start_ns;
+
+        ++p_pair->round_trips;
+    }
+
+    if (!p_pair->is_single) {
+        atomic_store(&p_pair->ping_done, true);
+        p_backend->signal(p_pair->p_pong);
+    }
+
+    return 0;
+}
+
+static int pong(bench_pair_t* p_pair) {
+    const bench_backend_t* p_backend = p_pair->p_options->p_backend;
+
+    if (p_pair->p_options->pin)
+        pin_to_cpu(p_pair->cpu_pong);
+
+    for (;;) {
+        if (p_backend->wait(p_pair->p_pong))
+            return EXIT_FAILURE;
+
+        if (atomic_load(&p_pair->ping_done))
+            return 0;
+
+        if (p_backend->signal(p_pair->p_ping))
+            return EXIT_FAILURE;
+    }
+}
+
+// Run ping-pong pairs on 'c_threads' threads, or a single thread signaling itself, and print one result row.
+static int run_ping_pong(const bench_options_t* p_options, unsigned c_threads) {
+    const bench_backend_t* p_backend = p_options->p_backend;
+    unsigned c_pairs = c_threads > 1 ? c_threads / 2 : 1;
+    bench_pair_t* p_pairs = calloc(c_pairs, sizeof(bench_pair_t));
+    atomic_bool stop = false;
+    unsigned c_ready = 0;
+    unsigned c_started = 0;
+    int status = EXIT_FAILURE;
+    bench_perf_t perf;
+
+    if (!p_pairs)
+        return EXIT_FAILURE;
+
+    for (size_t i = 0; i < BENCH_COUNTER_COUNT; ++i)
+        perf.fds[i] = -1;
+
+    for (; c_ready < c_pairs; ++c_ready) {
+        bench_pair_t* p_pair = &p_pairs[c_ready];
+
+        p_pair->p_options = p_options;
+        p_pair->p_stop = &stop;
+        p_pair->is_single = c_threads == 1;
+        p_pair->cpu_ping = 2 * c_ready;
+        p_pair->cpu_pong = 2 * c_ready + 1;
+        p_pair->p_ping = malloc(p_backend->get_size());
+        p_pair->p_pong = malloc(p_backend->get_size());
+        p_pair->p_samples = malloc(BENCH_MAX_SAMPLES * sizeof(uint64_t));
+
+        if (!p_pair->p_ping || !p_pair->p_pong || !p_pair->p_samples || p_backend->init(p_pair->p_ping))
+            goto clean_up;
+
+        if (p_backend->init(p_pair->p_pong)) {
+            p_backend->destroy(p_pair->p_ping);
+            goto clean_up;
+        }
+    }
+
+    // Opened before the threads are created so they inherit the counters.
+    if (p_options->counters) {
+        perf_open(&perf);
+        perf_enable(&perf, true);
+    }
+
+    uint64_t start_ns = now_ns();
+
+    for (; c_started < c_pairs; ++c_started) {
+        bench_pair_t* p_pair = &p_pairs[c_started];
+
+        if (!p_pair->is_single && thrd_create(&p_pair->thrd_pong, (thrd_start_t)pong, p_pair) != thrd_success)
+            break;
+
+        if (thrd_create(&p_pair->thrd_ping, (thrd_start_t)ping, p_pair) != thrd_success) {
+            atomic_store(&p_pair->ping_done, true);
+            p_backend->signal(p_pair->p_pong);
+            thrd_join(p_pair->thrd_pong, NULL);
+            break;
+        }
+    }
+
+    if (c_started == c_pairs)
+        thrd_sleep(&(struct timespec){.tv_sec = p_options->duration_ms / 1000, .tv_nsec = (long)(p_options->duration_ms % 1000) * 1000000}, NULL);
+
+    atomic_store(&stop, true);
+
+    for (unsigned i = 0; i < c_started; ++i) {
+        thrd_join(p_pairs[i].thrd_ping, NULL);
+        if (!p_pairs[i].is_single)
+            thrd_join(p_pairs[i].thrd_pong, NULL);
+    }
+
+    uint64_t elapsed_ns = now_ns() - start_ns;
+
+    if (p_options->counters)
+        perf_enable(&perf, false);
+
+    if (c_started != c_pairs) {
+        fprintf(stderr, "failed to start %u threads\n", c_threads);
+        goto clean_up;
+    }
+
+    uint64_t round_trips = 0;
+    size_t c_samples = 0;
+
+    for (unsigned i = 0; i < c_pairs; ++i) {
+        round_trips += p_pairs[i].round_trips;
+        c_samples += p_pairs[i].c_samples;
+    }
+
+    uint64_t* p_samples = malloc((c_samples ? c_samples : 1) * sizeof(uint64_t));
+    if (!p_samples)
+        goto clean_up;
+
+    c_samples = 0;
+    for (unsigned i = 0; i < c_pairs; ++i) {
+        memcpy(&p_samples[c_samples], p_pairs[i].p_samples, p_pairs[i].c_samples * sizeof(uint64_t));
+        c_samples += p_pairs[i].c_samples;
+    }
+
+    qsort(p_samples, c_samples, sizeof(uint64_t), cmp_u64);
+
+    double seconds = (double)elapsed_ns / 1e9;
+    printf("%-10s %8u %6u %14.0f %12ju %12ju %12ju", p_backend->name, c_threads, c_pairs, (double)round_trips / seconds,
+           (uintmax_t)percentile(p_samples, c_samples, 50), (uintmax_t)percentile(p_samples, c_samples, 99),
+           (uintmax_t)percentile(p_samples, c_samples, 99.9));
+
+    for (size_t i = 0; p_options->counters && i < BENCH_COUNTER_COUNT; ++i) {
+        double value;
+
+        if (perf_read(&perf, i, &value) && round_trips)
+            printf(" %14.2f", value / (double)round_trips);
+        else
+            printf(" %14s", "-");
+    }
+
+    putchar('\n');
+
+    free(p_samples);
+    status = EXIT_SUCCESS;
+
+clean_up:
+    perf_close(&perf);
+
+    for (unsigned i = 0; i < c_ready; ++i) {
+        p_backend->destroy(p_pairs[i].p_ping);
+        p_backend->destroy(p_pairs[i].p_pong);
+    }
+
+    for (unsigned i = 0; i < c_pairs; ++i) {
+        free(p_pairs[i].p_ping);
+        free(p_pairs[i].p_pong);
+        free(p_pairs[i].p_samples);
+    }
+
+    free(p_pairs);
+    return status;
+}
+
+// Backend events.c was built with, see events_backend.h.
+static const char* events_backend_name(void) {
+    event_footprint_t footprint;
+    return event_get_footprint(&footprint) ? "unknown" : footprint.backend;
+}
+
+static void print_header(const bench_options_t* p_options) {
+    printf("%-10s %8s %6s %14s %12s %12s %12s", "backend", "threads", "pairs", "round_trips/s", "p50_ns", "p99_ns", "p99.9_ns");
+
+    for (size_t i = 0; p_options->counters && i < BENCH_COUNTER_COUNT; ++i)
+        printf(" %14s", bench_counters[i].name);
+
+    putchar('\n');
+}
+
+// Sweep from one thread to four times the online CPUs: 1, powers of two, and every multiple of the CPU count,
+// so the points where threads start to outnumber cores are always measured. Pairs need even thread counts.
+static int bench_scale(const bench_options_t* p_options) {
+    unsigned c_cpus = online_cpus();
+    unsigned max_threads = 4 * c_cpus;
+
+    printf("# scale: %u online CPUs, %s, events on %s\n", c_cpus, p_options->pin ? "pinned" : "unpinned", events_backend_name());
+    print_header(p_options);
+
+    for (unsigned c_threads = 1; c_threads <= max_threads + 1;) {
+        if (run_ping_pong(p_options, c_threads))
+            return EXIT_FAILURE;
+
+        unsigned next = c_threads * 2;
+        for (unsigned multiple = 1; multiple <= 4; ++multiple) {
+            unsigned cpus_multiple = (multiple * c_cpus + 1) & ~1u;
+            if (cpus_multiple > c_threads && cpus_multiple < next)
+                next = cpus_multiple;
+        }
+
+        c_threads = next;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Run every backend at one thread, one pair, one pair per CPU and four threads per CPU.
+static int bench_compare(const bench_options_t* p_options) {
+    unsigned c_cpus = online_cpus();
+    unsigned thread_counts[] = {1, 2, (c_cpus + 1) & ~1u, 4 * c_cpus};
+    size_t c_thread_counts = sizeof(thread_counts) / sizeof(*thread_counts);
+
+    printf("# compare: %u online CPUs, %s, events on %s\n", c_cpus, p_options->pin ? "pinned" : "unpinned", events_backend_name());
+    print_header(p_options);
+
+    for (size_t i = 0; i < c_thread_counts; ++i) {
+        if (i && thread_counts[i] <= thread_counts[i - 1])
+            continue;
+
+        for (size_t j = 0; j < BENCH_BACKEND_COUNT; ++j) {
+            bench_options_t options = *p_options;
+            options.p_backend = &bench_backends[j];
+
+            if (run_ping_pong(&options, thread_counts[i]))
+                return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Cost of event_wait_multiple on N events that are already signaled, the last one when waiting for any, so every
+// call spawns all of its helpers. With events.c built with EVENTS_PROFILE the cost is split into its phases.
+static int bench_wait_multiple(const bench_options_t* p_options) {
+    static const size_t sizes[] = {2, 4, 8, 16, 32, 64};
+    event_phase_stats_t phases[EVENT_PHASE_COUNT];
+    bool have_phases = event_profile_get_phases(phases) == 0;
+
+    printf("# wait_multiple: per-call ns, events on %s%s\n", events_backend_name(), have_phases ? "" : ", phases need events.c built with -DEVENTS_PROFILE");
+    printf("%-4s %6s %10s %10s", "mode", "events", "calls/s", "ns/call");
+    for (int i = 0; i < EVENT_PHASE_COUNT; ++i)
+        printf(" %10s", event_phase_get_name((event_phase_t)i));
+    putchar('\n');
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); ++s) {
+        size_t c_events = sizes[s];
+        event_t** p_events = calloc(c_events, sizeof(event_t*));
+        size_t c_ready = 0;
+        int status = EXIT_FAILURE;
+
+        if (!p_events)
+            return EXIT_FAILURE;
+
+        for (; c_ready < c_events; ++c_ready) {
+            if (!(p_events[c_ready] = malloc(event_get_size())) || event_init(p_events[c_ready], false, false)) {
+                free(p_events[c_ready]);
+                goto clean_up;
+            }
+        }
+
+        for (int wait_all = 0; wait_all <= 1; ++wait_all) {
+            uint64_t c_calls = 0;
+            uint64_t end_ns = now_ns() + (uint64_t)p_options->duration_ms * 1000000u;
+            uint64_t start_ns;
+            uint64_t elapsed_ns;
+
+            event_profile_reset();
+            start_ns = now_ns();
+
+            do {
+                size_t idx;
+
+                for (size_t i = wait_all ? 0 : c_events - 1; i < c_events; ++i)
+                    event_signal(p_events[i]);
+
+                if (event_wait_multiple(p_events, c_events, wait_all, NULL, &idx)) {
+                    fprintf(stderr, "event_wait_multiple failed on %zu events\n", c_events);
+                    goto clean_up;
+                }
+
+                ++c_calls;
+            } while (now_ns() < end_ns);
+
+            elapsed_ns = now_ns() - start_ns;
+
+            printf("%-4s %6zu %10.0f %10.0f", wait_all ? "all" : "any", c_events, (double)c_calls / ((double)elapsed_ns / 1e9),
+                   (double)elapsed_ns / (double)c_calls);
+
+            if (have_phases)
+                event_profile_get_phases(phases);
+
+            for (int i = 0; i < EVENT_PHASE_COUNT; ++i) {
+                if (have_phases)
+                    printf(" %10.0f", (double)phases[i].total_ns / (double)c_calls);
+                else
+                    printf(" %10s", "-");
+            }
+
+            putchar('\n');
+        }
+
+        status = EXIT_SUCCESS;
+
+    clean_up:
+        for (size_t i = 0; i < c_ready; ++i) {
+            event_destroy(p_events[i]);
+            free(p_events[i]);
+        }
+
+        free(p_events);
+
+        if (status)
+            return status;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Read a "Vm...:  N kB" line of /proc/self/status, in bytes.
+static uint64_t proc_status_bytes(const char* key) {
+    FILE* p_file = fopen("/proc/self/status", "r");
+    char line[256];
+    uint64_t value = 0;
+    size_t c_key = strlen(key);
+
+    if (!p_file)
+        return 0;
+
+    while (fgets(line, sizeof(line), p_file)) {
+        if (!strncmp(line, key, c_key) && line[c_key] == ':') {
+            value = strtoull(line + c_key + 1, NULL, 10) * 1024u;
+            break;
+        }
+    }
+
+    fclose(p_file);
+    return value;
+}
+
+typedef struct footprint_waiter_t {
+    event_t** p_events;
+    size_t c_events;
+    atomic_bool primed;
+    atomic_bool go;
+    atomic_bool started;
+} footprint_waiter_t;
+
+static int footprint_wait(footprint_waiter_t* p_waiter) {
+    size_t idx;
+
+    // The first allocation of a thread creates its malloc arena, tens of megabytes of address space. Have that
+    // happen before the baseline, so that only the helpers of the wait are measured.
+    void* volatile p_arena = malloc(1);
+    free(p_arena);
+    atomic_store(&p_waiter->primed, true);
+    while (!atomic_load(&p_waiter->go))
+        thrd_yield();
+
+    atomic_store(&p_waiter->started, true);
+    return event_wait_multiple(p_waiter->p_events, p_waiter->c_events, false, NULL, &idx);
+}
+
+// Print what event_get_footprint reports, then measure it: resident memory of many initialized events, and virtual
+// and resident memory while one event_wait_multiple call is outstanding.
+static int bench_footprint(const bench_options_t* p_options) {
+    enum { C_EVENTS = 100000, C_WAIT_EVENTS = 64 };
+    event_footprint_t footprint;
+    int status = EXIT_FAILURE;
+
+    if (event_get_footprint(&footprint))
+        return EXIT_FAILURE;
+
+    printf("# footprint: %s backend\n", footprint.backend);
+    printf("event                    %8zu B\n", footprint.event_bytes);
+    printf("name                     %8zu B\n", footprint.name_bytes);
+    printf("wait_multiple per event  %8zu B heap, +%zu B waiting for all\n", footprint.wait_multiple_bytes, footprint.wait_all_bytes);
+    printf("helper stack per event   %8zu B virtual\n", footprint.helper_stack_bytes);
+    printf("instrumented thread      %8zu B\n", footprint.thread_bytes);
+    printf("static tables            %8zu B\n", footprint.static_bytes);
+
+    size_t c_event = event_get_size();
+    uint64_t rss_before = proc_status_bytes("VmRSS");
+    unsigned char* p_events = malloc(C_EVENTS * c_event);
+    size_t c_initialized = 0;
+    event_t* p_wait_events[C_WAIT_EVENTS];
+
+    if (!p_events)
+        return EXIT_FAILURE;
+
+    for (; c_initialized < C_EVENTS; ++c_initialized) {
+        if (event_init((event_t*)&p_events[c_initialized * c_event], false, false))
+            goto clean_up;
+    }
+
+    printf("measured event           %8.1f B resident, %u events\n", (double)(proc_status_bytes("VmRSS") - rss_before) / C_EVENTS,
+           (unsigned)C_EVENTS);
+
+    footprint_waiter_t waiter = {.p_events = p_wait_events, .c_events = C_WAIT_EVENTS};
+    thrd_t thrd;
+
+    for (size_t i = 0; i < C_WAIT_EVENTS; ++i)
+        p_wait_events[i] = (event_t*)&p_events[i * c_event];
+
+    // The waiting thread itself is not part of the cost, so it is created before the baseline.
+    if (thrd_create(&thrd, (thrd_start_t)footprint_wait, &waiter) != thrd_success)
+        goto clean_up;
+
+    while (!atomic_load(&waiter.primed))
+        thrd_yield();
+
+    uint64_t vm_before = proc_status_bytes("VmSize");
+    rss_before = proc_status_bytes("VmRSS");
+    atomic_store(&waiter.go, true);
+
+    // Helpers are all blocked well before the measurement duration is over.
+    while (!atomic_load(&waiter.started))
+        thrd_yield();
+    thrd_sleep(&(struct timespec){.tv_sec = p_options->duration_ms / 1000, .tv_nsec = (long)(p_options->duration_ms % 1000) * 1000000}, NULL);
+
+    uint64_t vm_during = proc_status_bytes("VmSize");
+    uint64_t rss_during = proc_status_bytes("VmRSS");
+
+    event_signal(p_wait_events[0]);
+    thrd_join(thrd, NULL);
+
+    printf("measured wait_multiple   %8.1f B virtual, %.1f B resident per event, %u events\n",
+           (double)(vm_during - vm_before) / C_WAIT_EVENTS, (double)(rss_during - rss_before) / C_WAIT_EVENTS, (unsigned)C_WAIT_EVENTS);
+
+    // The helpers' stacks are back in the cache now, so their resident pages can be counted.
+    if (!event_get_footprint(&footprint))
+        printf("helper stack resident    %8zu B, most used cached stack\n", footprint.helper_resident_bytes);
+    status = EXIT_SUCCESS;
+
+clean_up:
+    for (size_t i = 0; i < c_initialized; ++i)
+        event_destroy((event_t*)&p_events[i * c_event]);
+
+    free(p_events);
+    return status;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s <mode> [options]\n"
+            "modes:\n"
+            "  scale    ping-pong throughput and latency from 1 thread to 4x the online CPUs\n"
+            "  compare  ping-pong on every backend at 1 thread, 1 pair, 1 thread per CPU and 4 threads per CPU\n"
+            "  wait_multiple\n"
+            "           event_wait_multiple cost from 2 to 64 events, split into phases with -DEVENTS_PROFILE\n"
+            "  footprint\n"
+            "           reported and measured memory per event and per outstanding event_wait_multiple\n"
+            "options:\n"
+            "  -d MS    duration of each measurement (default 500)\n"
+            "  -n       do not pin threads to CPUs\n"
+            "  -c       report perf_event_open counters per round trip: context switches, cache misses, instructions\n"
+            "           and cycles, or '-' where the kernel does not allow or support them\n"
+            "  -b B     backend for scale: events, condvar, futex, eventfd or semaphore (default events)\n",
+            argv0);
+}
+
+int main(int argc, char** argv) {
+    bench_options_t options = {
+        .duration_ms = 500,
+        .pin = true,
+        .p_backend = &bench_backends[0],
+    };
+
+    if (argc < 2) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 2; i < argc; ++i) {
+        if (!strcmp(argv[i], "-n")) {
+            options.pin = false;
+        } else if (!strcmp(argv[i], "-c")) {
+            options.counters = true;
+        } else if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+            options.duration_ms = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+            const char* name = argv[++i];
+            options.p_backend = NULL;
+
+            for (size_t j = 0; j < BENCH_BACKEND_COUNT; ++j) {
+                if (!strcmp(bench_backends[j].name, name))
+                    options.p_backend = &bench_backends[j];
+            }
+
+            if (!options.p_backend) {
+                fprintf(stderr, "unknown backend '%s'\n", name);
+                return EXIT_FAILURE;
+            }
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!options.duration_ms) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!strcmp(argv[1], "scale"))
+        return bench_scale(&options);
+
+    if (!strcmp(argv[1], "compare"))
+        return bench_compare(&options);
+
+    if (!strcmp(argv[1], "wait_multiple"))
+        return bench_wait_multiple(&options);
+
+    if (!strcmp(argv[1], "footprint"))
+        return bench_footprint(&options);
+
+    usage(argv[0]);
+    return EXIT_FAILURE;
+}
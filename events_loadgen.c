@@ -0,0 +1,437 @@
+// SPDX-FileCopyrightText: 2022 Oliver Old <oliver.old@outlook.com>
+// SPDX-License-Identifier: MIT
+
+// Load generator simulating producer/consumer traffic on event_t.
+// Build: cc -std=c11 -O2 -pthread events.c events_loadgen.c -o events_loadgen
+
+#include "events.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+// Latency samples kept per consumer; later samples are dropped.
+#define LOADGEN_MAX_SAMPLES (1u << 20)
+
+typedef struct loadgen_config_t {
+    unsigned producers;
+    unsigned consumers;
+    unsigned events;
+    unsigned manual_percent;
+    unsigned set_size;
+    bool wait_all;
+    unsigned timeout_us;
+    unsigned producer_think_us;
+    unsigned consumer_think_us;
+    unsigned duration_s;
+    // Faults to inject, if events.c was built with EVENTS_FAULT_INJECTION.
+    event_fault_t faults[EVENT_FAULT_POINT_COUNT];
+} loadgen_config_t;
+
+static const char* const loadgen_fault_points[EVENT_FAULT_POINT_COUNT] = {"signal", "wait", "wake", "helper", "wait_multiple"};
+
+typedef struct loadgen_t {
+    loadgen_config_t config;
+    event_t** p_events;
+    // The first 'c_manual' events are manual-reset.
+    unsigned c_manual;
+    atomic_uint_least64_t* p_signal_ns;
+    atomic_bool stop;
+    atomic_uint consumers_done;
+    atomic_uint_least64_t signals;
+} loadgen_t;
+
+typedef struct loadgen_worker_t {
+    loadgen_t* p_loadgen;
+    thrd_t thrd;
+    unsigned idx;
+    uint64_t wakes;
+    uint64_t timeouts;
+    uint64_t* p_samples;
+    size_t c_samples;
+} loadgen_worker_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static struct timespec deadline_after_us(unsigned us) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    ts.tv_sec += us / 1000000;
+    ts.tv_nsec += (long)(us % 1000000) * 1000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_nsec -= 1000000000;
+        ++ts.tv_sec;
+    }
+    return ts;
+}
+
+static void think(unsigned us) {
+    if (us)
+        thrd_sleep(&(struct timespec){.tv_sec = us / 1000000, .tv_nsec = (long)(us % 1000000) * 1000}, NULL);
+}
+
+static uint32_t next_random(uint32_t* p_state) {
+    uint32_t x = *p_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *p_state = x;
+}
+
+static int producer(loadgen_worker_t* p_worker) {
+    loadgen_t* p_loadgen = p_worker->p_loadgen;
+    uint32_t random = 0x9E3779B9u * (p_worker->idx + 1);
+
+    while (!atomic_load_explicit(&p_loadgen->stop, memory_order_relaxed)) {
+        unsigned idx = next_random(&random) % p_loadgen->config.events;
+
+        atomic_store_explicit(&p_loadgen->p_signal_ns[idx], now_ns(), memory_order_relaxed);
+        if (event_signal(p_loadgen->p_events[idx]))
+            return EXIT_FAILURE;
+
+        atomic_fetch_add_explicit(&p_loadgen->signals, 1, memory_order_relaxed);
+        think(p_loadgen->config.producer_think_us);
+    }
+
+    return 0;
+}
+
+static void record_wake(loadgen_worker_t* p_worker, size_t idx_event) {
+    loadgen_t* p_loadgen = p_worker->p_loadgen;
+    uint64_t signal_ns = atomic_load_explicit(&p_loadgen->p_signal_ns[idx_event], memory_order_relaxed);
+    uint64_t wake_ns = now_ns();
+
+    ++p_worker->wakes;
+    if (signal_ns && wake_ns > signal_ns && p_worker->c_samples < LOADGEN_MAX_SAMPLES)
+        p_worker->p_samples[p_worker->c_samples++] = wake_ns - signal_ns;
+}
+
+static int consumer(loadgen_worker_t* p_worker) {
+    loadgen_t* p_loadgen = p_worker->p_loadgen;
+    loadgen_config_t* p_config = &p_loadgen->config;
+    event_t** p_set = malloc(p_config->set_size * sizeof(event_t*));
+    size_t* p_set_idx = malloc(p_config->set_size * sizeof(size_t));
+    uint32_t random = 0x85EBCA6Bu * (p_worker->idx + 1);
+
+    if (!p_set || !p_set_idx) {
+        free(p_set);
+        free(p_set_idx);
+        return EXIT_FAILURE;
+    }
+
+    while (!atomic_load_explicit(&p_loadgen->stop, memory_order_relaxed)) {
+        // Consecutive events starting at a random offset, so sets overlap between consumers.
+        size_t first = next_random(&random) % p_config->events;
+        for (size_t i = 0; i < p_config->set_size; ++i) {
+            p_set_idx[i] = (first + i) % p_config->events;
+            p_set[i] = p_loadgen->p_events[p_set_idx[i]];
+        }
+
+        struct timespec deadline;
+        if (p_config->timeout_us)
+            deadline = deadline_after_us(p_config->timeout_us);
+
+        size_t idx_signaled;
+        event_error_t err = event_wait_multiple(p_set, p_config->set_size, p_config->wait_all, p_config->timeout_us ? &deadline : NULL, &idx_signaled);
+
+        if (err == ETIMEDOUT) {
+            ++p_worker->timeouts;
+            continue;
+        }
+
+        if (err)
+            break;
+
+        if (atomic_load_explicit(&p_loadgen->stop, memory_order_relaxed))
+            break;
+
+        // Manual-reset events are reset by whoever consumes them.
+        for (size_t i = 0; i < p_config->set_size; ++i) {
+            if (!p_config->wait_all && i != idx_signaled)
+                continue;
+
+            record_wake(p_worker, p_set_idx[i]);
+            if (p_set_idx[i] < p_loadgen->c_manual)
+                event_reset(p_set[i]);
+        }
+
+        think(p_config->consumer_think_us);
+    }
+
+    atomic_fetch_add(&p_loadgen->consumers_done, 1);
+    free(p_set);
+    free(p_set_idx);
+    return 0;
+}
+
+static int cmp_u64(const void* p_lhs, const void* p_rhs) {
+    uint64_t lhs = *(const uint64_t*)p_lhs;
+    uint64_t rhs = *(const uint64_t*)p_rhs;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static uint64_t percentile(const uint64_t* p_sorted, size_t c_sorted, double p) {
+    if (!c_sorted)
+        return 0;
+
+    size_t idx = (size_t)(p / 100.0 * (double)(c_sorted - 1) + 0.5);
+    return p_sorted[idx];
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -p N   producer threads (default 2)\n"
+            "  -c N   consumer threads (default 2)\n"
+            "  -e N   events in the pool (default 4)\n"
+            "  -m N   percentage of manual-reset events (default 0)\n"
+            "  -k N   events per event_wait_multiple set (default 1)\n"
+            "  -a     wait for all events of a set instead of any\n"
+            "  -t US  wait timeout in microseconds, 0 for none (default 0)\n"
+            "  -z US  producer think time between signals (default 0)\n"
+            "  -Z US  consumer think time after a wake (default 0)\n"
+            "  -d S   duration in seconds (default 5)\n"
+            "  -f POINT:PPM:US\n"
+            "         inject a delay of up to US microseconds, or a yield if 0, with a chance of PPM per million at POINT:\n"
+            "         signal, wait, wake, helper or wait_multiple. Repeatable. Needs events.c built with EVENTS_FAULT_INJECTION\n",
+            argv0);
+}
+
+// Parse 'POINT:PPM:US'.
+static bool parse_fault(const char* arg, loadgen_config_t* p_config) {
+    const char* colon = strchr(arg, ':');
+    char* end;
+
+    if (!colon)
+        return false;
+
+    for (size_t i = 0; i < EVENT_FAULT_POINT_COUNT; ++i) {
+        if (strlen(loadgen_fault_points[i]) != (size_t)(colon - arg) || strncmp(loadgen_fault_points[i], arg, (size_t)(colon - arg)))
+            continue;
+
+        event_fault_t* p_fault = &p_config->faults[i];
+        unsigned long ppm = strtoul(colon + 1, &end, 10);
+        if (end == colon + 1 || *end != ':' || ppm > 1000000)
+            return false;
+
+        const char* us = end + 1;
+        unsigned long long max_delay_us = strtoull(us, &end, 10);
+        if (end == us || *end)
+            return false;
+
+        p_fault->probability_ppm = (uint32_t)ppm;
+        p_fault->min_delay_ns = 0;
+        p_fault->max_delay_ns = (uint64_t)max_delay_us * 1000u;
+        return true;
+    }
+
+    return false;
+}
+
+static bool parse_args(int argc, char** argv, loadgen_config_t* p_config) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        unsigned* p_value = NULL;
+
+        if (arg[0] != '-' || !arg[1] || arg[2])
+            return false;
+
+        switch (arg[1]) {
+            case 'p': p_value = &p_config->producers; break;
+            case 'c': p_value = &p_config->consumers; break;
+            case 'e': p_value = &p_config->events; break;
+            case 'm': p_value = &p_config->manual_percent; break;
+            case 'k': p_value = &p_config->set_size; break;
+            case 't': p_value = &p_config->timeout_us; break;
+            case 'z': p_value = &p_config->producer_think_us; break;
+            case 'Z': p_value = &p_config->consumer_think_us; break;
+            case 'd': p_value = &p_config->duration_s; break;
+            case 'a': p_config->wait_all = true; continue;
+            case 'f':
+                if (++i == argc || !parse_fault(argv[i], p_config))
+                    return false;
+                continue;
+            default: return false;
+        }
+
+        char* end;
+        if (++i == argc)
+            return false;
+
+        unsigned long value = strtoul(argv[i], &end, 10);
+        if (*end || end == argv[i])
+            return false;
+
+        *p_value = (unsigned)value;
+    }
+
+    return p_config->producers && p_config->consumers && p_config->events && p_config->set_size && p_config->set_size <= p_config->events &&
+           p_config->manual_percent <= 100 && p_config->duration_s;
+}
+
+int main(int argc, char** argv) {
+    loadgen_t loadgen = {
+        .config = {
+            .producers = 2,
+            .consumers = 2,
+            .events = 4,
+            .set_size = 1,
+            .duration_s = 5,
+        },
+    };
+    loadgen_config_t* p_config = &loadgen.config;
+    int status = EXIT_FAILURE;
+
+    if (!parse_args(argc, argv, p_config)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < EVENT_FAULT_POINT_COUNT; ++i) {
+        if (p_config->faults[i].probability_ppm && event_fault_set((event_fault_point_t)i, &p_config->faults[i])) {
+            fprintf(stderr, "fault injection needs events.c built with EVENTS_FAULT_INJECTION\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    unsigned c_workers = p_config->producers + p_config->consumers;
+    unsigned c_manual = loadgen.c_manual = (unsigned)((uint64_t)p_config->events * p_config->manual_percent / 100);
+    unsigned c_initialized = 0;
+
+    loadgen.p_events = calloc(p_config->events, sizeof(event_t*));
+    loadgen.p_signal_ns = calloc(p_config->events, sizeof(atomic_uint_least64_t));
+    loadgen_worker_t* p_workers = calloc(c_workers, sizeof(loadgen_worker_t));
+
+    if (!loadgen.p_events || !loadgen.p_signal_ns || !p_workers)
+        goto clean_up;
+
+    for (; c_initialized < p_config->events; ++c_initialized) {
+        if (!(loadgen.p_events[c_initialized] = malloc(event_get_size())))
+            goto clean_up;
+
+        if (event_init(loadgen.p_events[c_initialized], c_initialized < c_manual, false)) {
+            free(loadgen.p_events[c_initialized]);
+            goto clean_up;
+        }
+    }
+
+    for (unsigned i = 0; i < p_config->consumers; ++i) {
+        if (!(p_workers[p_config->producers + i].p_samples = malloc(LOADGEN_MAX_SAMPLES * sizeof(uint64_t))))
+            goto clean_up;
+    }
+
+    uint64_t start_ns = now_ns();
+    unsigned c_started;
+
+    for (c_started = 0; c_started < c_workers; ++c_started) {
+        loadgen_worker_t* p_worker = &p_workers[c_started];
+        bool is_producer = c_started < p_config->producers;
+
+        p_worker->p_loadgen = &loadgen;
+        p_worker->idx = c_started;
+        if (thrd_create(&p_worker->thrd, (thrd_start_t)(is_producer ? producer : consumer), p_worker) != thrd_success)
+            break;
+    }
+
+    if (c_started == c_workers)
+        thrd_sleep(&(struct timespec){.tv_sec = p_config->duration_s}, NULL);
+
+    atomic_store(&loadgen.stop, true);
+
+    for (unsigned i = 0; i < c_started && i < p_config->producers; ++i)
+        thrd_join(p_workers[i].thrd, NULL);
+
+    uint64_t elapsed_ns = now_ns() - start_ns;
+
+    // Stop injecting so that shutdown is not slowed down by it.
+    for (size_t i = 0; i < EVENT_FAULT_POINT_COUNT; ++i) {
+        if (p_config->faults[i].probability_ppm)
+            event_fault_set((event_fault_point_t)i, NULL);
+    }
+
+    // Consumers may still be blocked; keep signaling every event until they have all seen the stop flag.
+    while (atomic_load(&loadgen.consumers_done) < c_started - (c_started < p_config->producers ? c_started : p_config->producers)) {
+        for (unsigned i = 0; i < p_config->events; ++i)
+            event_signal(loadgen.p_events[i]);
+
+        think(1000);
+    }
+
+    for (unsigned i = p_config->producers; i < c_started; ++i)
+        thrd_join(p_workers[i].thrd, NULL);
+
+    if (c_started != c_workers) {
+        fprintf(stderr, "failed to start worker threads\n");
+        goto clean_up;
+    }
+
+    uint64_t wakes = 0;
+    uint64_t timeouts = 0;
+    size_t c_samples = 0;
+
+    for (unsigned i = p_config->producers; i < c_workers; ++i) {
+        wakes += p_workers[i].wakes;
+        timeouts += p_workers[i].timeouts;
+        c_samples += p_workers[i].c_samples;
+    }
+
+    uint64_t* p_samples = malloc((c_samples ? c_samples : 1) * sizeof(uint64_t));
+    if (!p_samples)
+        goto clean_up;
+
+    c_samples = 0;
+    for (unsigned i = p_config->producers; i < c_workers; ++i) {
+        memcpy(&p_samples[c_samples], p_workers[i].p_samples, p_workers[i].c_samples * sizeof(uint64_t));
+        c_samples += p_workers[i].c_samples;
+    }
+
+    qsort(p_samples, c_samples, sizeof(uint64_t), cmp_u64);
+
+    double seconds = (double)elapsed_ns / 1e9;
+    uint64_t signals = atomic_load(&loadgen.signals);
+
+    printf("producers %u, consumers %u, events %u (%u manual-reset), set size %u (%s), timeout %u us, think %u/%u us\n", p_config->producers,
+           p_config->consumers, p_config->events, c_manual, p_config->set_size, p_config->wait_all ? "all" : "any", p_config->timeout_us,
+           p_config->producer_think_us, p_config->consumer_think_us);
+    printf("duration     %.3f s\n", seconds);
+    printf("signals      %ju (%.0f/s)\n", (uintmax_t)signals, (double)signals / seconds);
+    printf("wakes        %ju (%.0f/s)\n", (uintmax_t)wakes, (double)wakes / seconds);
+    printf("timeouts     %ju\n", (uintmax_t)timeouts);
+    printf("latency ns   p50 %ju  p90 %ju  p99 %ju  p99.9 %ju  max %ju\n", (uintmax_t)percentile(p_samples, c_samples, 50),
+           (uintmax_t)percentile(p_samples, c_samples, 90), (uintmax_t)percentile(p_samples, c_samples, 99),
+           (uintmax_t)percentile(p_samples, c_samples, 99.9), (uintmax_t)(c_samples ? p_samples[c_samples - 1] : 0));
+
+    for (size_t i = 0; i < EVENT_FAULT_POINT_COUNT; ++i) {
+        uint64_t count;
+
+        if (p_config->faults[i].probability_ppm && !event_fault_get_count((event_fault_point_t)i, &count))
+            printf("faults       %s %ju\n", loadgen_fault_points[i], (uintmax_t)count);
+    }
+
+    free(p_samples);
+    status = EXIT_SUCCESS;
+
+clean_up:
+    for (unsigned i = 0; i < c_initialized; ++i) {
+        event_destroy(loadgen.p_events[i]);
+        free(loadgen.p_events[i]);
+    }
+
+    if (p_workers) {
+        for (unsigned i = 0; i < c_workers; ++i)
+            free(p_workers[i].p_samples);
+    }
+
+    free(p_workers);
+    free(loadgen.p_signal_ns);
+    free(loadgen.p_events);
+    return status;
+}
@@ -0,0 +1,998 @@
+// SPDX-FileCopyrightText: 2022 Oliver Old <oliver.old@outlook.com>
+// SPDX-License-Identifier: MIT
+
+// Functional tests for event_t. Exits with a failure status if any test fails.
+// Build: cc -std=c11 -O2 -pthread events.c events_test.c -o events_test
+// Add -DEVENTS_BACKEND_PTHREAD, -DEVENTS_BACKEND_FUTEX or -DEVENTS_BACKEND_PARKING_LOT to test another backend.
+
+#include "events.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+
+// Short enough to keep the run quick, long enough for a thread to block first on a loaded machine.
+#define TEST_SHORT_MS 50
+
+#define C_TEST_EVENTS 4
+
+// Threads and iterations per thread of the lock tests.
+#define C_TEST_LOCKERS 4
+#define C_TEST_LOCK_ITERATIONS 20000
+
+// Values published by the watch and snapshot tests.
+#define C_TEST_PUBLISHES 2000
+
+// Report a failed check and leave the test through its clean_up label.
+#define CHECK(expr)                                                                  \
+    do {                                                                             \
+        if (!(expr)) {                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr); \
+            goto clean_up;                                                           \
+        }                                                                            \
+    } while (0)
+
+typedef struct test_waiter_t {
+    event_t* p_event;
+    event_t** p_events;
+    size_t c_events;
+    bool wait_all;
+    struct timespec time;
+    size_t idx;
+    atomic_bool done;
+    event_error_t err;
+    thrd_t thrd;
+} test_waiter_t;
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static struct timespec deadline_in_ms(unsigned ms) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (long)(ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_nsec -= 1000000000;
+        ++ts.tv_sec;
+    }
+    return ts;
+}
+
+static void sleep_ms(unsigned ms) {
+    thrd_sleep(&(struct timespec){.tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000}, NULL);
+}
+
+static event_t* new_event(bool is_manual_reset, bool initial_state) {
+    event_t* p_event = malloc(event_get_size());
+    if (p_event && event_init(p_event, is_manual_reset, initial_state)) {
+        free(p_event);
+        return NULL;
+    }
+    return p_event;
+}
+
+static void delete_event(event_t* p_event) {
+    if (p_event) {
+        event_destroy(p_event);
+        free(p_event);
+    }
+}
+
+static int waiter_run(test_waiter_t* p_waiter) {
+    if (p_waiter->p_events)
+        p_waiter->err = event_wait_multiple(p_waiter->p_events, p_waiter->c_events, p_waiter->wait_all, &p_waiter->time, &p_waiter->idx);
+    else
+        p_waiter->err = event_wait(p_waiter->p_event, &p_waiter->time);
+
+    atomic_store(&p_waiter->done, true);
+    return 0;
+}
+
+static bool waiter_start(test_waiter_t* p_waiter) {
+    atomic_init(&p_waiter->done, false);
+    return thrd_create(&p_waiter->thrd, (thrd_start_t)waiter_run, p_waiter) == thrd_success;
+}
+
+static bool test_timed_wait(void) {
+    event_t* p_event = new_event(false, false);
+    bool ok = false;
+    CHECK(p_event);
+
+    uint64_t start_ms = now_ms();
+    struct timespec time = deadline_in_ms(TEST_SHORT_MS);
+    CHECK(event_wait(p_event, &time) == ETIMEDOUT);
+    CHECK(now_ms() - start_ms >= TEST_SHORT_MS - 1);
+
+    // A deadline in the past expires at once.
+    CHECK(event_wait(p_event, &(struct timespec){.tv_sec = 1}) == ETIMEDOUT);
+
+    CHECK(!event_signal(p_event));
+    time = deadline_in_ms(TEST_SHORT_MS);
+    CHECK(!event_wait(p_event, &time));
+    ok = true;
+
+clean_up:
+    delete_event(p_event);
+    return ok;
+}
+
+static bool test_far_future_wait(void) {
+    test_waiter_t waiter = {
+        .p_event = new_event(false, false),
+        .time = {.tv_sec = sizeof(time_t) > 4 ? (time_t)((int_least64_t)1 << 40) : (time_t)INT32_MAX},
+    };
+    bool ok = false;
+    CHECK(waiter.p_event);
+    CHECK(waiter_start(&waiter));
+
+    // A deadline too far out to convert must still block instead of expiring at once.
+    sleep_ms(TEST_SHORT_MS);
+    bool early = atomic_load(&waiter.done);
+
+    event_signal(waiter.p_event);
+    thrd_join(waiter.thrd, NULL);
+    CHECK(!early);
+    CHECK(!waiter.err);
+    ok = true;
+
+clean_up:
+    delete_event(waiter.p_event);
+    return ok;
+}
+
+static bool test_manual_reset(void) {
+    event_t* p_event = new_event(true, false);
+    test_waiter_t waiters[2];
+    size_t c_started = 0;
+    bool ok = false;
+    CHECK(p_event);
+
+    for (; c_started < sizeof(waiters) / sizeof(*waiters); ++c_started) {
+        waiters[c_started] = (test_waiter_t){.p_event = p_event, .time = deadline_in_ms(20 * TEST_SHORT_MS)};
+        if (!waiter_start(&waiters[c_started]))
+            break;
+    }
+
+    // One signal releases every waiter and the event stays signaled.
+    sleep_ms(TEST_SHORT_MS);
+    event_signal(p_event);
+    for (size_t i = 0; i < c_started; ++i)
+        thrd_join(waiters[i].thrd, NULL);
+
+    CHECK(c_started == sizeof(waiters) / sizeof(*waiters));
+    for (size_t i = 0; i < c_started; ++i)
+        CHECK(!waiters[i].err);
+
+    struct timespec time = deadline_in_ms(TEST_SHORT_MS);
+    CHECK(!event_wait(p_event, &time));
+    CHECK(!event_wait(p_event, &time));
+
+    CHECK(!event_reset(p_event));
+    time = deadline_in_ms(TEST_SHORT_MS);
+    CHECK(event_wait(p_event, &time) == ETIMEDOUT);
+    ok = true;
+
+clean_up:
+    delete_event(p_event);
+    return ok;
+}
+
+static bool test_auto_reset(void) {
+    event_t* p_event = new_event(false, true);
+    test_waiter_t waiters[2];
+    size_t c_started = 0;
+    bool ok = false;
+    CHECK(p_event);
+
+    // The initial state is consumed by the first wait.
+    struct timespec time = deadline_in_ms(TEST_SHORT_MS);
+    CHECK(!event_wait(p_event, &time));
+    CHECK(event_wait(p_event, &time) == ETIMEDOUT);
+
+    for (; c_started < sizeof(waiters) / sizeof(*waiters); ++c_started) {
+        waiters[c_started] = (test_waiter_t){.p_event = p_event, .time = deadline_in_ms(4 * TEST_SHORT_MS)};
+        if (!waiter_start(&waiters[c_started]))
+            break;
+    }
+
+    // One signal releases exactly one waiter, the other times out.
+    sleep_ms(TEST_SHORT_MS);
+    event_signal(p_event);
+    for (size_t i = 0; i < c_started; ++i)
+        thrd_join(waiters[i].thrd, NULL);
+
+    CHECK(c_started == sizeof(waiters) / sizeof(*waiters));
+    CHECK(!waiters[0].err != !waiters[1].err);
+    CHECK(waiters[0].err == ETIMEDOUT || waiters[1].err == ETIMEDOUT);
+    ok = true;
+
+clean_up:
+    delete_event(p_event);
+    return ok;
+}
+
+static bool test_wait_multiple_any(void) {
+    event_t* p_events[C_TEST_EVENTS] = {0};
+    size_t idx = SIZE_MAX;
+    bool ok = false;
+
+    for (size_t i = 0; i < C_TEST_EVENTS; ++i)
+        CHECK(p_events[i] = new_event(false, false));
+
+    struct timespec time = deadline_in_ms(TEST_SHORT_MS);
+    CHECK(event_wait_multiple(p_events, C_TEST_EVENTS, false, &time, &idx) == ETIMEDOUT);
+
+    // An already signaled event is reported and consumed.
+    CHECK(!event_signal(p_events[2]));
+    time = deadline_in_ms(TEST_SHORT_MS);
+    CHECK(!event_wait_multiple(p_events, C_TEST_EVENTS, false, &time, &idx));
+    CHECK(idx == 2);
+    CHECK(event_wait(p_events[2], &(struct timespec){.tv_sec = 1}) == ETIMEDOUT);
+
+    // A blocked wait is released by a later signal.
+    test_waiter_t waiter = {.p_events = p_events, .c_events = C_TEST_EVENTS, .time = deadline_in_ms(20 * TEST_SHORT_MS)};
+    CHECK(waiter_start(&waiter));
+    sleep_ms(TEST_SHORT_MS);
+    event_signal(p_events[3]);
+    thrd_join(waiter.thrd, NULL);
+    CHECK(!waiter.err);
+    CHECK(waiter.idx == 3);
+    ok = true;
+
+clean_up:
+    for (size_t i = 0; i < C_TEST_EVENTS; ++i)
+        delete_event(p_events[i]);
+    return ok;
+}
+
+static bool test_wait_multiple_all(void) {
+    event_t* p_events[C_TEST_EVENTS] = {0};
+    size_t idx;
+    bool ok = false;
+
+    // The first event is manual reset, the others auto reset.
+    for (size_t i = 0; i < C_TEST_EVENTS; ++i)
+        CHECK(p_events[i] = new_event(i == 0, false));
+
+    // Not all are signaled, so the wait times out.
+    for (size_t i = 0; i < C_TEST_EVENTS - 1; ++i)
+        CHECK(!event_signal(p_events[i]));
+    struct timespec time = deadline_in_ms(TEST_SHORT_MS);
+    CHECK(event_wait_multiple(p_events, C_TEST_EVENTS, true, &time, &idx) == ETIMEDOUT);
+
+    // A blocked wait is released once the last event is signaled.
+    test_waiter_t waiter = {.p_events = p_events, .c_events = C_TEST_EVENTS, .wait_all = true, .time = deadline_in_ms(20 * TEST_SHORT_MS)};
+    CHECK(waiter_start(&waiter));
+    sleep_ms(TEST_SHORT_MS);
+    bool early = atomic_load(&waiter.done);
+    event_signal(p_events[C_TEST_EVENTS - 1]);
+    thrd_join(waiter.thrd, NULL);
+    CHECK(!early);
+    CHECK(!waiter.err);
+
+    // The auto reset events were consumed, the manual reset one stays signaled.
+    CHECK(!event_wait(p_events[0], &(struct timespec){.tv_sec = 1}));
+    for (size_t i = 1; i < C_TEST_EVENTS; ++i)
+        CHECK(event_wait(p_events[i], &(struct timespec){.tv_sec = 1}) == ETIMEDOUT);
+    ok = true;
+
+clean_up:
+    for (size_t i = 0; i < C_TEST_EVENTS; ++i)
+        delete_event(p_events[i]);
+    return ok;
+}
+
+typedef struct test_commit_t {
+    // The first commit signals 'p_entered' and then holds until 'p_release' is signaled.
+    event_t* p_entered;
+    event_t* p_release;
+    atomic_int c_calls;
+    size_t c_items[2];
+} test_commit_t;
+
+typedef struct test_submitter_t {
+    event_group_commit_t* p_group;
+    // Set by the commit to the number of the call it was committed in.
+    int call;
+    int result;
+    event_error_t err;
+    thrd_t thrd;
+} test_submitter_t;
+
+static int test_commit(void* ctx, void* const* p_items, size_t c_items) {
+    test_commit_t* p_commit = ctx;
+    int call = atomic_fetch_add(&p_commit->c_calls, 1) + 1;
+
+    if (call <= 2)
+        p_commit->c_items[call - 1] = c_items;
+    for (size_t i = 0; i < c_items; ++i)
+        ((test_submitter_t*)p_items[i])->call = call;
+
+    if (call == 1) {
+        event_signal(p_commit->p_entered);
+        event_wait(p_commit->p_release, NULL);
+    }
+    return 100 + call;
+}
+
+static int submitter_run(test_submitter_t* p_submitter) {
+    p_submitter->err = event_group_commit_submit(p_submitter->p_group, p_submitter, &p_submitter->result);
+    return 0;
+}
+
+static bool test_group_commit(void) {
+    test_commit_t commit = {.p_entered = new_event(false, false), .p_release = new_event(true, false)};
+    event_group_commit_t* p_group = malloc(event_group_commit_get_size());
+    test_submitter_t submitters[4];
+    size_t c_started = 0;
+    bool initialized = false;
+    bool ok = false;
+
+    atomic_init(&commit.c_calls, 0);
+    CHECK(commit.p_entered && commit.p_release && p_group);
+    CHECK(!event_group_commit_init(p_group, test_commit, &commit));
+    initialized = true;
+
+    // The first submitter leads a batch of its own and holds it in the commit.
+    submitters[0] = (test_submitter_t){.p_group = p_group};
+    CHECK(thrd_create(&submitters[0].thrd, (thrd_start_t)submitter_run, &submitters[0]) == thrd_success);
+    ++c_started;
+    CHECK(!event_wait(commit.p_entered, NULL));
+
+    // The others arrive while it commits and are coalesced into the next batch.
+    for (; c_started < sizeof(submitters) / sizeof(*submitters); ++c_started) {
+        submitters[c_started] = (test_submitter_t){.p_group = p_group};
+        if (thrd_create(&submitters[c_started].thrd, (thrd_start_t)submitter_run, &submitters[c_started]) != thrd_success)
+            break;
+    }
+
+    sleep_ms(TEST_SHORT_MS);
+    int c_calls_held = atomic_load(&commit.c_calls);
+    event_signal(commit.p_release);
+    for (size_t i = 0; i < c_started; ++i)
+        thrd_join(submitters[i].thrd, NULL);
+
+    CHECK(c_started == sizeof(submitters) / sizeof(*submitters));
+    CHECK(c_calls_held == 1);
+    CHECK(atomic_load(&commit.c_calls) == 2);
+    CHECK(commit.c_items[0] == 1);
+    CHECK(commit.c_items[1] == c_started - 1);
+
+    // Every caller got the result of the batch its item was committed in.
+    CHECK(!submitters[0].err && submitters[0].call == 1 && submitters[0].result == 101);
+    for (size_t i = 1; i < c_started; ++i)
+        CHECK(!submitters[i].err && submitters[i].call == 2 && submitters[i].result == 102);
+    ok = true;
+
+clean_up:
+    if (initialized)
+        event_group_commit_destroy(p_group);
+    free(p_group);
+    delete_event(commit.p_entered);
+    delete_event(commit.p_release);
+    return ok;
+}
+
+typedef struct test_counter_t {
+    event_t* p_event;
+    atomic_int value;
+    int target;
+} test_counter_t;
+
+static bool counter_reached(void* ctx) {
+    test_counter_t* p_counter = ctx;
+    return atomic_load(&p_counter->value) >= p_counter->target;
+}
+
+// Count up to the target, signaling the event after each step.
+static int counter_run(test_counter_t* p_counter) {
+    for (int i = 0; i < p_counter->target; ++i) {
+        sleep_ms(TEST_SHORT_MS / 5);
+        atomic_fetch_add(&p_counter->value, 1);
+        event_signal(p_counter->p_event);
+    }
+    return 0;
+}
+
+static bool test_wait_until(void) {
+    test_counter_t counter = {.p_event = new_event(false, false), .target = 3};
+    thrd_t thrd;
+    bool ok = false;
+
+    atomic_init(&counter.value, 0);
+    CHECK(counter.p_event);
+
+    struct timespec time = deadline_in_ms(TEST_SHORT_MS);
+    CHECK(event_wait_until(counter.p_event, counter_reached, &counter, &time) == ETIMEDOUT);
+
+    // Signals before the predicate holds do not end the wait.
+    CHECK(thrd_create(&thrd, (thrd_start_t)counter_run, &counter) == thrd_success);
+    time = deadline_in_ms(20 * TEST_SHORT_MS);
+    event_error_t err = event_wait_until(counter.p_event, counter_reached, &counter, &time);
+    int value = atomic_load(&counter.value);
+    thrd_join(thrd, NULL);
+    CHECK(!err);
+    CHECK(value >= counter.target);
+
+    // The signal of the auto-reset event was not consumed.
+    CHECK(!event_wait(counter.p_event, &(struct timespec){.tv_sec = 1}));
+    ok = true;
+
+clean_up:
+    delete_event(counter.p_event);
+    return ok;
+}
+
+typedef struct test_version_waiter_t {
+    event_t* p_event;
+    uint_least64_t version;
+    struct timespec time;
+    atomic_bool done;
+    event_error_t err;
+    thrd_t thrd;
+} test_version_waiter_t;
+
+static int version_waiter_run(test_version_waiter_t* p_waiter) {
+    p_waiter->err = event_wait_changed(p_waiter->p_event, &p_waiter->version, &p_waiter->time);
+    atomic_store(&p_waiter->done, true);
+    return 0;
+}
+
+static bool test_wait_changed(void) {
+    test_version_waiter_t waiter = {.p_event = new_event(true, false)};
+    uint_least64_t version;
+    bool ok = false;
+
+    CHECK(waiter.p_event);
+    CHECK(!event_get_version(waiter.p_event, &version));
+    uint_least64_t last_seen_version = version;
+    struct timespec time = deadline_in_ms(TEST_SHORT_MS);
+    CHECK(event_wait_changed(waiter.p_event, &last_seen_version, &time) == ETIMEDOUT);
+    CHECK(last_seen_version == version);
+
+    // A signal advances the version and wakes the waiter.
+    waiter.version = version;
+    waiter.time = deadline_in_ms(20 * TEST_SHORT_MS);
+    atomic_init(&waiter.done, false);
+    CHECK(thrd_create(&waiter.thrd, (thrd_start_t)version_waiter_run, &waiter) == thrd_success);
+    sleep_ms(TEST_SHORT_MS);
+    bool early = atomic_load(&waiter.done);
+    event_signal(waiter.p_event);
+    thrd_join(waiter.thrd, NULL);
+    CHECK(!early);
+    CHECK(!waiter.err);
+    CHECK(waiter.version == version + 1);
+
+    // A signal undone by a reset before the next call is still seen.
+    last_seen_version = waiter.version;
+    CHECK(!event_signal(waiter.p_event));
+    CHECK(!event_reset(waiter.p_event));
+    CHECK(!event_wait_changed(waiter.p_event, &last_seen_version, &(struct timespec){.tv_sec = 1}));
+    CHECK(last_seen_version == version + 2);
+    ok = true;
+
+clean_up:
+    delete_event(waiter.p_event);
+    return ok;
+}
+
+typedef struct test_address_waiter_t {
+    _Atomic uint32_t* p_word;
+    uint32_t expected;
+    struct timespec time;
+    atomic_bool done;
+    event_error_t err;
+    thrd_t thrd;
+} test_address_waiter_t;
+
+static int address_waiter_run(test_address_waiter_t* p_waiter) {
+    p_waiter->err = event_wait_on_address(p_waiter->p_word, &p_waiter->expected, sizeof(p_waiter->expected), &p_waiter->time);
+    atomic_store(&p_waiter->done, true);
+    return 0;
+}
+
+static bool test_wait_on_address(void) {
+    static _Atomic uint32_t word;
+    test_address_waiter_t waiters[2];
+    size_t c_started = 0;
+    uint32_t expected = 1;
+    bool ok = false;
+
+    // A value that already differs returns at once, a matching one waits for the deadline.
+    uint64_t start_ms = now_ms();
+    struct timespec time = deadline_in_ms(20 * TEST_SHORT_MS);
+    CHECK(!event_wait_on_address(&word, &expected, sizeof(expected), &time));
+    CHECK(now_ms() - start_ms < 20 * TEST_SHORT_MS);
+    expected = 0;
+    time = deadline_in_ms(TEST_SHORT_MS);
+    CHECK(event_wait_on_address(&word, &expected, sizeof(expected), &time) == ETIMEDOUT);
+
+    for (; c_started < sizeof(waiters) / sizeof(*waiters); ++c_started) {
+        waiters[c_started] = (test_address_waiter_t){.p_word = &word, .time = deadline_in_ms(20 * TEST_SHORT_MS)};
+        atomic_init(&waiters[c_started].done, false);
+        if (thrd_create(&waiters[c_started].thrd, (thrd_start_t)address_waiter_run, &waiters[c_started]) != thrd_success)
+            break;
+    }
+
+    // Waking one releases one waiter, waking all releases the rest.
+    sleep_ms(TEST_SHORT_MS);
+    atomic_store(&word, 1);
+    event_wake_by_address_single((const void*)&word);
+    sleep_ms(TEST_SHORT_MS);
+    unsigned c_woken_single = 0;
+    for (size_t i = 0; i < c_started; ++i)
+        c_woken_single += atomic_load(&waiters[i].done);
+
+    event_wake_by_address_all((const void*)&word);
+    for (size_t i = 0; i < c_started; ++i)
+        thrd_join(waiters[i].thrd, NULL);
+
+    CHECK(c_started == sizeof(waiters) / sizeof(*waiters));
+    CHECK(c_woken_single == 1);
+    for (size_t i = 0; i < c_started; ++i)
+        CHECK(!waiters[i].err);
+    ok = true;
+
+clean_up:
+    return ok;
+}
+
+// Published value spanning several words, so that a torn copy shows as differing words.
+typedef struct test_value_t {
+    uint64_t words[8];
+} test_value_t;
+
+static void value_fill(test_value_t* p_value, uint64_t word) {
+    for (size_t i = 0; i < sizeof(p_value->words) / sizeof(*p_value->words); ++i)
+        p_value->words[i] = word;
+}
+
+static bool value_is(const test_value_t* p_value, uint64_t word) {
+    for (size_t i = 0; i < sizeof(p_value->words) / sizeof(*p_value->words); ++i) {
+        if (p_value->words[i] != word)
+            return false;
+    }
+    return true;
+}
+
+static int watch_publisher_run(event_watch_t* p_watch) {
+    test_value_t value;
+
+    for (uint64_t i = 1; i <= C_TEST_PUBLISHES; ++i) {
+        value_fill(&value, i);
+        event_watch_publish(p_watch, &value);
+        if (i % 16 == 0)
+            thrd_yield();
+    }
+    return 0;
+}
+
+static bool test_watch(void) {
+    event_watch_t* p_watch = malloc(event_watch_get_size(sizeof(test_value_t)));
+    test_value_t value;
+    uint_least64_t version;
+    bool initialized = false;
+    bool ok = false;
+
+    CHECK(p_watch);
+    CHECK(!event_watch_get_size(SIZE_MAX));
+    value_fill(&value, 7);
+    CHECK(!event_watch_init(p_watch, &value, sizeof(value)));
+    initialized = true;
+
+    value_fill(&value, 0);
+    CHECK(!event_watch_read(p_watch, &value, &version));
+    CHECK(version == 0 && value_is(&value, 7));
+    struct timespec time = deadline_in_ms(TEST_SHORT_MS);
+    CHECK(event_watch_wait(p_watch, &version, &value, &time) == ETIMEDOUT);
+
+    // Waiters wake for new versions and always copy out a whole value, the one of the version they get.
+    thrd_t thrd;
+    CHECK(thrd_create(&thrd, (thrd_start_t)watch_publisher_run, p_watch) == thrd_success);
+
+    uint_least64_t last_seen_version = 0;
+    bool consistent = true;
+    event_error_t err = 0;
+
+    while (last_seen_version < C_TEST_PUBLISHES) {
+        uint_least64_t previous_version = last_seen_version;
+        time = deadline_in_ms(20 * TEST_SHORT_MS);
+        if ((err = event_watch_wait(p_watch, &last_seen_version, &value, &time)))
+            break;
+        consistent &= last_seen_version > previous_version && value_is(&value, last_seen_version);
+    }
+    thrd_join(thrd, NULL);
+    CHECK(!err);
+    CHECK(consistent);
+    ok = true;
+
+clean_up:
+    if (initialized)
+        event_watch_destroy(p_watch);
+    free(p_watch);
+    return ok;
+}
+
+static int snapshot_writer_run(event_snapshot_t* p_snapshot) {
+    for (uint64_t i = 1; i <= C_TEST_PUBLISHES; ++i) {
+        test_value_t* p_back;
+
+        if (event_snapshot_begin_write(p_snapshot, i % 2, (void**)&p_back))
+            break;
+
+        // Fill in two halves with a yield between, so that a reader copying this buffer would see it torn.
+        for (size_t j = 0; j < sizeof(p_back->words) / sizeof(*p_back->words); ++j) {
+            if (j == sizeof(p_back->words) / sizeof(*p_back->words) / 2)
+                thrd_yield();
+            p_back->words[j] = i;
+        }
+        event_snapshot_publish(p_snapshot);
+    }
+    return 0;
+}
+
+static bool test_snapshot(void) {
+    event_snapshot_t* p_snapshot = malloc(event_snapshot_get_size(sizeof(test_value_t)));
+    test_value_t value;
+    test_value_t* p_back;
+    uint_least64_t version;
+    bool initialized = false;
+    bool ok = false;
+
+    CHECK(p_snapshot);
+    CHECK(!event_snapshot_get_size(SIZE_MAX / 2));
+    CHECK(!event_snapshot_init(p_snapshot, NULL, sizeof(value)));
+    initialized = true;
+
+    struct timespec time = deadline_in_ms(TEST_SHORT_MS);
+    version = 0;
+    CHECK(event_snapshot_wait(p_snapshot, &version, &value, &time) == ETIMEDOUT);
+
+    // Readers never see a torn snapshot, and always the one of the version they get.
+    thrd_t thrd;
+    CHECK(thrd_create(&thrd, (thrd_start_t)snapshot_writer_run, p_snapshot) == thrd_success);
+
+    uint_least64_t last_seen_version = 0;
+    bool consistent = true;
+    event_error_t err = 0;
+
+    while (last_seen_version < C_TEST_PUBLISHES) {
+        uint_least64_t previous_version = last_seen_version;
+
+        if ((err = event_snapshot_read(p_snapshot, &value, &version)))
+            break;
+        consistent &= version >= previous_version && value_is(&value, version);
+
+        time = deadline_in_ms(20 * TEST_SHORT_MS);
+        if ((err = event_snapshot_wait(p_snapshot, &last_seen_version, &value, &time)))
+            break;
+        consistent &= last_seen_version > previous_version && value_is(&value, last_seen_version);
+    }
+    thrd_join(thrd, NULL);
+    CHECK(!err);
+    CHECK(consistent);
+
+    // A cancelled write is not published.
+    CHECK(!event_snapshot_begin_write(p_snapshot, false, (void**)&p_back));
+    value_fill(p_back, 0);
+    CHECK(!event_snapshot_cancel_write(p_snapshot));
+    CHECK(!event_snapshot_read(p_snapshot, &value, &version));
+    CHECK(version == C_TEST_PUBLISHES && value_is(&value, C_TEST_PUBLISHES));
+    ok = true;
+
+clean_up:
+    if (initialized)
+        event_snapshot_destroy(p_snapshot);
+    free(p_snapshot);
+    return ok;
+}
+
+typedef struct test_locks_t {
+    event_mutex_t mutex;
+    event_rwlock_t rwlock;
+    // Guarded by 'mutex'.
+    unsigned long counter;
+    // Guarded by 'rwlock'. Writers change both values, readers must always see them equal.
+    unsigned long pair[2];
+    atomic_uint c_readers;
+    atomic_uint c_writers;
+    atomic_bool violated;
+} test_locks_t;
+
+static int mutex_locker_run(test_locks_t* p_locks) {
+    for (unsigned i = 0; i < C_TEST_LOCK_ITERATIONS; ++i) {
+        if (event_mutex_lock(&p_locks->mutex)) {
+            atomic_store(&p_locks->violated, true);
+            break;
+        }
+        ++p_locks->counter;
+        event_mutex_unlock(&p_locks->mutex);
+    }
+    return 0;
+}
+
+static int rwlock_locker_run(test_locks_t* p_locks) {
+    for (unsigned i = 0; i < C_TEST_LOCK_ITERATIONS; ++i) {
+        // Every fourth pass writes.
+        if (i % 4 == 0) {
+            if (event_rwlock_write_lock(&p_locks->rwlock)) {
+                atomic_store(&p_locks->violated, true);
+                break;
+            }
+            if (atomic_fetch_add(&p_locks->c_writers, 1) || atomic_load(&p_locks->c_readers))
+                atomic_store(&p_locks->violated, true);
+            ++p_locks->pair[0];
+            thrd_yield();
+            ++p_locks->pair[1];
+            atomic_fetch_sub(&p_locks->c_writers, 1);
+            event_rwlock_write_unlock(&p_locks->rwlock);
+        } else {
+            if (event_rwlock_read_lock(&p_locks->rwlock)) {
+                atomic_store(&p_locks->violated, true);
+                break;
+            }
+            atomic_fetch_add(&p_locks->c_readers, 1);
+            if (atomic_load(&p_locks->c_writers) || p_locks->pair[0] != p_locks->pair[1])
+                atomic_store(&p_locks->violated, true);
+            atomic_fetch_sub(&p_locks->c_readers, 1);
+            event_rwlock_read_unlock(&p_locks->rwlock);
+        }
+    }
+    return 0;
+}
+
+static bool run_lockers(test_locks_t* p_locks, thrd_start_t run) {
+    thrd_t thrds[C_TEST_LOCKERS];
+    size_t c_started = 0;
+
+    for (; c_started < C_TEST_LOCKERS; ++c_started) {
+        if (thrd_create(&thrds[c_started], run, p_locks) != thrd_success)
+            break;
+    }
+    for (size_t i = 0; i < c_started; ++i)
+        thrd_join(thrds[i], NULL);
+    return c_started == C_TEST_LOCKERS;
+}
+
+static bool test_mutex(void) {
+    static test_locks_t locks = {.mutex = EVENT_MUTEX_INIT};
+    bool ok = false;
+
+    // No increment is lost under contention.
+    CHECK(run_lockers(&locks, (thrd_start_t)mutex_locker_run));
+    CHECK(!atomic_load(&locks.violated));
+    CHECK(locks.counter == (unsigned long)C_TEST_LOCKERS * C_TEST_LOCK_ITERATIONS);
+
+    CHECK(!event_mutex_lock(&locks.mutex));
+    CHECK(event_mutex_trylock(&locks.mutex) == EBUSY);
+    uint64_t start_ms = now_ms();
+    struct timespec time = deadline_in_ms(TEST_SHORT_MS);
+    CHECK(event_mutex_timedlock(&locks.mutex, &time) == ETIMEDOUT);
+    CHECK(now_ms() - start_ms >= TEST_SHORT_MS - 1);
+    CHECK(!event_mutex_unlock(&locks.mutex));
+
+    time = deadline_in_ms(TEST_SHORT_MS);
+    CHECK(!event_mutex_timedlock(&locks.mutex, &time));
+    CHECK(!event_mutex_unlock(&locks.mutex));
+    ok = true;
+
+clean_up:
+    return ok;
+}
+
+static bool test_rwlock(void) {
+    static test_locks_t locks = {.rwlock = EVENT_RWLOCK_INIT};
+    bool ok = false;
+
+    // Writers exclude everyone, readers only exclude writers.
+    CHECK(run_lockers(&locks, (thrd_start_t)rwlock_locker_run));
+    CHECK(!atomic_load(&locks.violated));
+    CHECK(locks.pair[0] == (unsigned long)C_TEST_LOCKERS * C_TEST_LOCK_ITERATIONS / 4);
+    CHECK(locks.pair[1] == locks.pair[0]);
+
+    CHECK(!event_rwlock_read_lock(&locks.rwlock));
+    CHECK(!event_rwlock_try_read_lock(&locks.rwlock));
+    CHECK(event_rwlock_try_write_lock(&locks.rwlock) == EBUSY);
+    CHECK(!event_rwlock_read_unlock(&locks.rwlock));
+    CHECK(!event_rwlock_read_unlock(&locks.rwlock));
+
+    CHECK(!event_rwlock_try_write_lock(&locks.rwlock));
+    CHECK(event_rwlock_try_read_lock(&locks.rwlock) == EBUSY);
+    CHECK(event_rwlock_try_write_lock(&locks.rwlock) == EBUSY);
+    CHECK(!event_rwlock_write_unlock(&locks.rwlock));
+    ok = true;
+
+clean_up:
+    return ok;
+}
+
+typedef struct test_flight_t {
+    // The first computation signals 'p_entered' and then holds until 'p_release' is signaled.
+    event_t* p_entered;
+    event_t* p_release;
+    atomic_int c_calls;
+} test_flight_t;
+
+typedef struct test_flight_caller_t {
+    event_single_flight_t* p_flights;
+    test_flight_t* p_flight;
+    void* value;
+    bool shared;
+    event_error_t err;
+    thrd_t thrd;
+} test_flight_caller_t;
+
+static void* test_compute(void* ctx) {
+    test_flight_t* p_flight = ctx;
+    int call = atomic_fetch_add(&p_flight->c_calls, 1) + 1;
+
+    if (call == 1) {
+        event_signal(p_flight->p_entered);
+        event_wait(p_flight->p_release, NULL);
+    }
+    return (void*)(intptr_t)call;
+}
+
+static int flight_caller_run(test_flight_caller_t* p_caller) {
+    p_caller->err = event_single_flight_do(p_caller->p_flights, "key", 3, test_compute, p_caller->p_flight, &p_caller->value, &p_caller->shared);
+    return 0;
+}
+
+static bool test_single_flight(void) {
+    test_flight_t flight = {.p_entered = new_event(false, false), .p_release = new_event(true, false)};
+    event_single_flight_t* p_flights = malloc(event_single_flight_get_size());
+    test_flight_caller_t callers[4];
+    size_t c_started = 0;
+    bool initialized = false;
+    bool ok = false;
+
+    atomic_init(&flight.c_calls, 0);
+    CHECK(flight.p_entered && flight.p_release && p_flights);
+    CHECK(!event_single_flight_init(p_flights));
+    initialized = true;
+
+    // The first caller computes and holds its computation.
+    callers[0] = (test_flight_caller_t){.p_flights = p_flights, .p_flight = &flight};
+    CHECK(thrd_create(&callers[0].thrd, (thrd_start_t)flight_caller_run, &callers[0]) == thrd_success);
+    ++c_started;
+    CHECK(!event_wait(flight.p_entered, NULL));
+
+    // The others ask for the same key meanwhile and wait for that computation.
+    for (; c_started < sizeof(callers) / sizeof(*callers); ++c_started) {
+        callers[c_started] = (test_flight_caller_t){.p_flights = p_flights, .p_flight = &flight};
+        if (thrd_create(&callers[c_started].thrd, (thrd_start_t)flight_caller_run, &callers[c_started]) != thrd_success)
+            break;
+    }
+
+    sleep_ms(TEST_SHORT_MS);
+    event_signal(flight.p_release);
+    for (size_t i = 0; i < c_started; ++i)
+        thrd_join(callers[i].thrd, NULL);
+
+    CHECK(c_started == sizeof(callers) / sizeof(*callers));
+    CHECK(atomic_load(&flight.c_calls) == 1);
+    for (size_t i = 0; i < c_started; ++i)
+        CHECK(!callers[i].err && callers[i].value == (void*)1 && callers[i].shared);
+
+    // Once the computation finished, the key is computed again.
+    CHECK(!flight_caller_run(&callers[0]));
+    CHECK(!callers[0].err && callers[0].value == (void*)2 && !callers[0].shared);
+    ok = true;
+
+clean_up:
+    if (initialized)
+        event_single_flight_destroy(p_flights);
+    free(p_flights);
+    delete_event(flight.p_entered);
+    delete_event(flight.p_release);
+    return ok;
+}
+
+typedef struct test_batch_consumer_t {
+    event_batch_t* p_batch;
+    size_t c_items;
+    struct timespec time;
+    atomic_bool done;
+    event_error_t err;
+    thrd_t thrd;
+} test_batch_consumer_t;
+
+static int batch_consumer_run(test_batch_consumer_t* p_consumer) {
+    p_consumer->err = event_batch_wait(p_consumer->p_batch, &p_consumer->c_items, &p_consumer->time);
+    atomic_store(&p_consumer->done, true);
+    return 0;
+}
+
+static bool test_batch(void) {
+    event_batch_t* p_batch = malloc(event_batch_get_size());
+    test_batch_consumer_t consumer = {.p_batch = p_batch};
+    size_t c_items;
+    bool initialized = false;
+    bool ok = false;
+
+    // Due at 4 items or long after the first one.
+    CHECK(p_batch);
+    CHECK(!event_batch_init(p_batch, 4, &(struct timespec){.tv_sec = 10}));
+    initialized = true;
+
+    struct timespec time = deadline_in_ms(TEST_SHORT_MS);
+    CHECK(event_batch_wait(p_batch, &c_items, &time) == ETIMEDOUT);
+    CHECK(!event_batch_take(p_batch, &c_items) && !c_items);
+
+    // The consumer is released once the size is reached, not by the first item.
+    consumer.time = deadline_in_ms(20 * TEST_SHORT_MS);
+    atomic_init(&consumer.done, false);
+    CHECK(thrd_create(&consumer.thrd, (thrd_start_t)batch_consumer_run, &consumer) == thrd_success);
+    event_batch_add(p_batch, 1);
+    sleep_ms(TEST_SHORT_MS);
+    bool early = atomic_load(&consumer.done);
+    event_batch_add(p_batch, 3);
+    thrd_join(consumer.thrd, NULL);
+    CHECK(!early);
+    CHECK(!consumer.err && consumer.c_items == 4);
+    event_batch_destroy(p_batch);
+    initialized = false;
+
+    // Due at 100 items or shortly after the first one.
+    CHECK(!event_batch_init(p_batch, 100, &(struct timespec){.tv_nsec = TEST_SHORT_MS * 1000000}));
+    initialized = true;
+
+    // Below the size, the items are flushed once the delay since the first one has passed.
+    uint64_t start_ms = now_ms();
+    CHECK(!event_batch_add(p_batch, 2));
+    time = deadline_in_ms(20 * TEST_SHORT_MS);
+    CHECK(!event_batch_wait(p_batch, &c_items, &time));
+    CHECK(c_items == 2);
+    CHECK(now_ms() - start_ms >= TEST_SHORT_MS - 1);
+    ok = true;
+
+clean_up:
+    if (initialized)
+        event_batch_destroy(p_batch);
+    free(p_batch);
+    return ok;
+}
+
+int main(void) {
+    static const struct {
+        const char* name;
+        bool (*run)(void);
+    } tests[] = {
+        {"timed wait", test_timed_wait},
+        {"far future wait", test_far_future_wait},
+        {"manual reset", test_manual_reset},
+        {"auto reset", test_auto_reset},
+        {"wait_multiple any", test_wait_multiple_any},
+        {"wait_multiple all", test_wait_multiple_all},
+        {"wait_on_address", test_wait_on_address},
+        {"wait_until", test_wait_until},
+        {"wait_changed", test_wait_changed},
+        {"mutex", test_mutex},
+        {"rwlock", test_rwlock},
+        {"watch", test_watch},
+        {"snapshot", test_snapshot},
+        {"group commit", test_group_commit},
+        {"single_flight", test_single_flight},
+        {"batch", test_batch},
+    };
+    event_footprint_t footprint = {0};
+    unsigned c_failed = 0;
+
+    event_get_footprint(&footprint);
+    printf("backend %s\n", footprint.backend ? footprint.backend : "?");
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(*tests); ++i) {
+        bool ok = tests[i].run();
+        printf("%-20s %s\n", tests[i].name, ok ? "ok" : "FAIL");
+        c_failed += !ok;
+    }
+
+    return c_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}